@@ -0,0 +1,425 @@
+/* Synthetic xdg-shell clients for benchmarking rwm, see ./build.sh bench.
+ *
+ * Each client is its own connection with one toplevel that redraws a small
+ * square at a fixed rate (-r, or on every frame callback with -r 0) and
+ * damages only what changed. Prints commit and frame callback statistics
+ * after -t seconds. */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <wayland-client.h>
+#include "xdg-shell-client-protocol.h"
+
+#define MAX_CLIENTS   64
+#define SQUARE        32
+#define HIST_US       100   /* commit to frame callback histogram resolution ... */
+#define HIST_BUCKETS  10000 /* ... up to 1 s */
+
+struct buffer {
+	struct wl_buffer *wl_buffer;
+	uint32_t *data;
+	size_t size;
+	int square_x;          /* where this buffer last had the square drawn */
+	bool busy;
+};
+
+struct client {
+	int id;
+	struct wl_display *display;
+	struct wl_compositor *compositor;
+	struct wl_shm *shm;
+	struct xdg_wm_base *wm_base;
+	struct wl_surface *surface;
+	struct xdg_surface *xdg_surface;
+	struct xdg_toplevel *toplevel;
+	struct buffer buffers[2];
+	int width, height;
+	int pending_width, pending_height;
+	bool configured;
+	struct wl_callback *frame;
+	uint64_t frame_commit_ns;  /* commit the pending frame callback belongs to */
+	uint64_t next_commit_ns;
+	int square_x;              /* square position on screen */
+	uint32_t color;
+};
+
+static struct {
+	int rate;                  /* commits per second per client, 0 = frame callback paced */
+	int width, height;
+	uint64_t commits, skipped, frames;
+	uint32_t hist[HIST_BUCKETS];
+} bench = { .rate = 60, .width = 640, .height = 480 };
+
+/* ========================================================================== */
+/* Utility                                                                     */
+/* ========================================================================== */
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void fill_rect(struct buffer *buf, int stride, int x, int y, int w, int h, uint32_t color) {
+	for (int row = y; row < y + h; row++)
+		for (int col = x; col < x + w; col++)
+			buf->data[row * stride + col] = color;
+}
+
+static double percentile(double p) {
+	uint64_t target = (uint64_t)(p * (double)(bench.frames - 1));
+	uint64_t seen = 0;
+	for (int i = 0; i < HIST_BUCKETS; i++) {
+		seen += bench.hist[i];
+		if (seen > target) return (i + 1) * HIST_US / 1000.0;
+	}
+	return HIST_BUCKETS * HIST_US / 1000.0;
+}
+
+/* ========================================================================== */
+/* Buffers                                                                     */
+/* ========================================================================== */
+
+static void buffer_release(void *data, struct wl_buffer *wl_buffer) {
+	struct buffer *buf = data;
+	(void)wl_buffer;
+	buf->busy = false;
+}
+
+static const struct wl_buffer_listener buffer_listener = {
+	.release = buffer_release,
+};
+
+static void destroy_buffers(struct client *c) {
+	for (int i = 0; i < 2; i++) {
+		struct buffer *buf = &c->buffers[i];
+		if (buf->wl_buffer) wl_buffer_destroy(buf->wl_buffer);
+		if (buf->data) munmap(buf->data, buf->size);
+		memset(buf, 0, sizeof(*buf));
+	}
+}
+
+static bool create_buffers(struct client *c) {
+	int stride = c->width * 4;
+	size_t size = (size_t)stride * (size_t)c->height;
+	int fd = memfd_create("rwm-bench", MFD_CLOEXEC);
+	if (fd < 0 || ftruncate(fd, (off_t)(size * 2)) < 0) {
+		fprintf(stderr, "bench: shm: %s\n", strerror(errno));
+		if (fd >= 0) close(fd);
+		return false;
+	}
+	void *data = mmap(NULL, size * 2, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		fprintf(stderr, "bench: mmap: %s\n", strerror(errno));
+		close(fd);
+		return false;
+	}
+	struct wl_shm_pool *pool = wl_shm_create_pool(c->shm, fd, (int32_t)(size * 2));
+	for (int i = 0; i < 2; i++) {
+		struct buffer *buf = &c->buffers[i];
+		buf->wl_buffer = wl_shm_pool_create_buffer(pool, (int32_t)size * i,
+			c->width, c->height, stride, WL_SHM_FORMAT_XRGB8888);
+		wl_buffer_add_listener(buf->wl_buffer, &buffer_listener, buf);
+		buf->data = (uint32_t *)data + (size / 4) * (size_t)i;
+		buf->size = i == 0 ? size * 2 : 0;  /* the first buffer owns the mapping */
+		buf->square_x = -1;
+		fill_rect(buf, c->width, 0, 0, c->width, c->height, c->color);
+	}
+	wl_shm_pool_destroy(pool);
+	close(fd);
+	return true;
+}
+
+/* ========================================================================== */
+/* Drawing                                                                     */
+/* ========================================================================== */
+
+static void frame_done(void *data, struct wl_callback *callback, uint32_t time);
+
+static const struct wl_callback_listener frame_listener = {
+	.done = frame_done,
+};
+
+/* Move the square one step and commit, damaging its old and new position */
+static void draw(struct client *c) {
+	struct buffer *buf = !c->buffers[0].busy ? &c->buffers[0] :
+		!c->buffers[1].busy ? &c->buffers[1] : NULL;
+	if (!buf) {
+		bench.skipped++;
+		return;
+	}
+	int y = (c->height - SQUARE) / 2;
+	int span = c->width - SQUARE;
+	int old_x = c->square_x;
+	c->square_x = span > 0 ? (c->square_x + 4) % span : 0;
+
+	if (buf->square_x >= 0)
+		fill_rect(buf, c->width, buf->square_x, y, SQUARE, SQUARE, c->color);
+	fill_rect(buf, c->width, c->square_x, y, SQUARE, SQUARE, ~c->color | 0xff000000u);
+	buf->square_x = c->square_x;
+	buf->busy = true;
+
+	wl_surface_attach(c->surface, buf->wl_buffer, 0, 0);
+	wl_surface_damage_buffer(c->surface, old_x, y, SQUARE, SQUARE);
+	wl_surface_damage_buffer(c->surface, c->square_x, y, SQUARE, SQUARE);
+	if (!c->frame) {
+		c->frame = wl_surface_frame(c->surface);
+		wl_callback_add_listener(c->frame, &frame_listener, c);
+		c->frame_commit_ns = now_ns();
+	}
+	wl_surface_commit(c->surface);
+	bench.commits++;
+}
+
+static void frame_done(void *data, struct wl_callback *callback, uint32_t time) {
+	struct client *c = data;
+	(void)time;
+	wl_callback_destroy(callback);
+	c->frame = NULL;
+	uint64_t us = (now_ns() - c->frame_commit_ns) / 1000;
+	bench.hist[us / HIST_US < HIST_BUCKETS ? us / HIST_US : HIST_BUCKETS - 1]++;
+	bench.frames++;
+	if (bench.rate == 0) draw(c);
+}
+
+/* ========================================================================== */
+/* xdg-shell                                                                   */
+/* ========================================================================== */
+
+static void wm_base_ping(void *data, struct xdg_wm_base *wm_base, uint32_t serial) {
+	(void)data;
+	xdg_wm_base_pong(wm_base, serial);
+}
+
+static const struct xdg_wm_base_listener wm_base_listener = {
+	.ping = wm_base_ping,
+};
+
+static void xdg_surface_configure(void *data, struct xdg_surface *xdg_surface, uint32_t serial) {
+	struct client *c = data;
+	xdg_surface_ack_configure(xdg_surface, serial);
+	int w = c->pending_width > 0 ? c->pending_width : bench.width;
+	int h = c->pending_height > 0 ? c->pending_height : bench.height;
+	if (c->configured && w == c->width && h == c->height) return;
+
+	destroy_buffers(c);
+	c->width = w;
+	c->height = h;
+	c->square_x = 0;
+	if (!create_buffers(c)) return;
+	c->configured = true;
+	draw(c);
+}
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+	.configure = xdg_surface_configure,
+};
+
+static void toplevel_configure(void *data, struct xdg_toplevel *toplevel,
+		int32_t width, int32_t height, struct wl_array *states) {
+	struct client *c = data;
+	(void)toplevel; (void)states;
+	c->pending_width = width;
+	c->pending_height = height;
+}
+
+static void toplevel_close(void *data, struct xdg_toplevel *toplevel) {
+	(void)data; (void)toplevel;
+}
+
+static const struct xdg_toplevel_listener toplevel_listener = {
+	.configure = toplevel_configure,
+	.close = toplevel_close,
+};
+
+static void registry_global(void *data, struct wl_registry *registry,
+		uint32_t name, const char *interface, uint32_t version) {
+	struct client *c = data;
+	(void)version;
+	if (!strcmp(interface, wl_compositor_interface.name))
+		c->compositor = wl_registry_bind(registry, name, &wl_compositor_interface, 4);
+	else if (!strcmp(interface, wl_shm_interface.name))
+		c->shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+	else if (!strcmp(interface, xdg_wm_base_interface.name))
+		c->wm_base = wl_registry_bind(registry, name, &xdg_wm_base_interface, 1);
+}
+
+static void registry_global_remove(void *data, struct wl_registry *registry, uint32_t name) {
+	(void)data; (void)registry; (void)name;
+}
+
+static const struct wl_registry_listener registry_listener = {
+	.global = registry_global,
+	.global_remove = registry_global_remove,
+};
+
+static bool connect_client(struct client *c, int id) {
+	c->id = id;
+	c->color = 0xff000000u | (uint32_t)(id * 0x3f6b1d + 0x406080);
+	c->display = wl_display_connect(NULL);
+	if (!c->display) {
+		fprintf(stderr, "bench: cannot connect to the compositor\n");
+		return false;
+	}
+	struct wl_registry *registry = wl_display_get_registry(c->display);
+	wl_registry_add_listener(registry, &registry_listener, c);
+	wl_display_roundtrip(c->display);
+	wl_registry_destroy(registry);
+	if (!c->compositor || !c->shm || !c->wm_base) {
+		fprintf(stderr, "bench: compositor lacks wl_compositor, wl_shm or xdg_wm_base\n");
+		return false;
+	}
+	xdg_wm_base_add_listener(c->wm_base, &wm_base_listener, c);
+
+	char title[32];
+	snprintf(title, sizeof(title), "bench %d", id);
+	c->surface = wl_compositor_create_surface(c->compositor);
+	c->xdg_surface = xdg_wm_base_get_xdg_surface(c->wm_base, c->surface);
+	xdg_surface_add_listener(c->xdg_surface, &xdg_surface_listener, c);
+	c->toplevel = xdg_surface_get_toplevel(c->xdg_surface);
+	xdg_toplevel_add_listener(c->toplevel, &toplevel_listener, c);
+	xdg_toplevel_set_title(c->toplevel, title);
+	xdg_toplevel_set_app_id(c->toplevel, "rwm-bench");
+	wl_surface_commit(c->surface);
+	return true;
+}
+
+static void disconnect_client(struct client *c) {
+	if (!c->display) return;
+	if (c->frame) wl_callback_destroy(c->frame);
+	destroy_buffers(c);
+	if (c->toplevel) xdg_toplevel_destroy(c->toplevel);
+	if (c->xdg_surface) xdg_surface_destroy(c->xdg_surface);
+	if (c->surface) wl_surface_destroy(c->surface);
+	if (c->wm_base) xdg_wm_base_destroy(c->wm_base);
+	if (c->shm) wl_shm_destroy(c->shm);
+	if (c->compositor) wl_compositor_destroy(c->compositor);
+	wl_display_disconnect(c->display);
+}
+
+/* ========================================================================== */
+/* Main                                                                        */
+/* ========================================================================== */
+
+static int arg_int(const char *str, int min, int max) {
+	char *end = NULL;
+	long val = strtol(str, &end, 10);
+	if (*end || val < min || val > max) {
+		fprintf(stderr, "bench: %s is not in %d..%d\n", str, min, max);
+		exit(2);
+	}
+	return (int)val;
+}
+
+int main(int argc, char **argv) {
+	int nclients = 4, seconds = 10, opt;
+	while ((opt = getopt(argc, argv, "n:r:t:s:")) != -1) {
+		switch (opt) {
+		case 'n': nclients = arg_int(optarg, 1, MAX_CLIENTS); break;
+		case 'r': bench.rate = arg_int(optarg, 0, 10000); break;
+		case 't': seconds = arg_int(optarg, 1, 3600); break;
+		case 's':
+			if (sscanf(optarg, "%dx%d", &bench.width, &bench.height) != 2 ||
+					bench.width < SQUARE || bench.height < SQUARE) {
+				fprintf(stderr, "bench: bad size %s\n", optarg);
+				return 2;
+			}
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n clients] [-r commits/s, 0 = per frame] "
+				"[-t seconds] [-s WxH]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	static struct client clients[MAX_CLIENTS];
+	struct pollfd fds[MAX_CLIENTS];
+	for (int i = 0; i < nclients; i++) {
+		if (!connect_client(&clients[i], i + 1)) {
+			for (int j = 0; j <= i; j++) disconnect_client(&clients[j]);
+			return 1;
+		}
+		fds[i] = (struct pollfd){ .fd = wl_display_get_fd(clients[i].display), .events = POLLIN };
+	}
+
+	uint64_t start = now_ns();
+	uint64_t end = start + (uint64_t)seconds * 1000000000u;
+	uint64_t period = bench.rate ? 1000000000u / (uint64_t)bench.rate : 0;
+	for (int i = 0; i < nclients; i++)
+		clients[i].next_commit_ns = start + period * (uint64_t)i / (uint64_t)nclients;
+
+	struct rusage usage_start;
+	getrusage(RUSAGE_SELF, &usage_start);
+	bool ok = true;
+	for (uint64_t now = start; now < end && ok; now = now_ns()) {
+		/* Fixed-rate commits; a client whose buffers are all busy skips a beat */
+		uint64_t deadline = end;
+		for (int i = 0; i < nclients; i++) {
+			struct client *c = &clients[i];
+			if (!c->configured) continue;
+			if (!period) {
+				/* Frame paced: restart a chain that stalled on busy buffers */
+				if (!c->frame) draw(c);
+				continue;
+			}
+			if (now >= c->next_commit_ns) {
+				draw(c);
+				while (c->next_commit_ns <= now) c->next_commit_ns += period;
+			}
+			if (c->next_commit_ns < deadline) deadline = c->next_commit_ns;
+		}
+
+		for (int i = 0; i < nclients; i++) {
+			while (wl_display_prepare_read(clients[i].display) != 0)
+				wl_display_dispatch_pending(clients[i].display);
+			wl_display_flush(clients[i].display);
+		}
+		int timeout = deadline > now ? (int)((deadline - now + 999999) / 1000000) : 0;
+		if (poll(fds, (nfds_t)nclients, timeout) < 0 && errno != EINTR) ok = false;
+		for (int i = 0; i < nclients; i++) {
+			if (fds[i].revents & POLLIN) {
+				if (wl_display_read_events(clients[i].display) < 0) ok = false;
+			} else {
+				wl_display_cancel_read(clients[i].display);
+			}
+			if (fds[i].revents & (POLLERR | POLLHUP)) ok = false;
+			if (wl_display_dispatch_pending(clients[i].display) < 0) ok = false;
+		}
+	}
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	double secs = (double)(now_ns() - start) / 1e9;
+	double cpu = (double)(usage.ru_utime.tv_sec - usage_start.ru_utime.tv_sec) +
+		(double)(usage.ru_stime.tv_sec - usage_start.ru_stime.tv_sec) +
+		(double)(usage.ru_utime.tv_usec - usage_start.ru_utime.tv_usec) / 1e6 +
+		(double)(usage.ru_stime.tv_usec - usage_start.ru_stime.tv_usec) / 1e6;
+
+	if (bench.rate)
+		printf("bench: %d clients at %d commits/s, %.1f s\n", nclients, bench.rate, secs);
+	else
+		printf("bench: %d clients paced by frame callbacks, %.1f s\n", nclients, secs);
+	if (!ok) printf("bench: connection to the compositor lost\n");
+	printf("bench: %" PRIu64 " commits (%.1f/s), %" PRIu64 " skipped waiting for a buffer\n",
+		bench.commits, (double)bench.commits / secs, bench.skipped);
+	if (bench.frames)
+		printf("bench: commit to frame callback ms p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n",
+			percentile(0.5), percentile(0.9), percentile(0.99), percentile(1.0));
+	printf("bench: client cpu %.1f%%\n", 100.0 * cpu / secs);
+	fflush(stdout);
+
+	for (int i = 0; i < nclients; i++) disconnect_client(&clients[i]);
+	return ok ? 0 : 1;
+}
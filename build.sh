@@ -129,3 +129,20 @@ scan-build --status-bugs \
 ${CC:-cc} $CFLAGS $SANITIZE $SECURITY -I. -o rwm.elf rwm.c sysinfo.c $LDFLAGS
 
 [ "$DEBUG" = "1" ] && echo "Debug build with ASan+UBSan enabled"
+
+# Benchmark: ./build.sh bench [rwm-bench.elf options], e.g. ./build.sh bench -n 8 -r 0
+if [ "$1" = "bench" ]; then
+	shift
+	wayland-scanner client-header \
+		/usr/share/wayland-protocols/stable/xdg-shell/xdg-shell.xml \
+		xdg-shell-client-protocol.h
+	wayland-scanner private-code \
+		/usr/share/wayland-protocols/stable/xdg-shell/xdg-shell.xml \
+		xdg-shell-protocol.c
+
+	${CC:-cc} -std=c99 -O2 $(pkg-config --cflags wayland-client) -c -o xdg-shell-protocol.o xdg-shell-protocol.c
+	${CC:-cc} $CFLAGS $SANITIZE $SECURITY $(pkg-config --cflags wayland-client) \
+		-I. -o rwm-bench.elf bench.c xdg-shell-protocol.o $(pkg-config --libs wayland-client) $LDFLAGS
+
+	RWM_HEADLESS=${RWM_HEADLESS:-1920x1080} RWM_BENCH="./rwm-bench.elf $*" ./rwm.elf
+fi
@@ -3,21 +3,29 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
 #include <time.h>
 #include <unistd.h>
 #include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
 #include <systemd/sd-bus.h>
 
 #include <wayland-server-core.h>
 #include <wlr/backend.h>
+#include <wlr/backend/headless.h>
 #include <wlr/backend/libinput.h>
 #include <wlr/render/allocator.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_damage_ring.h>
 #include <wlr/types/wlr_subcompositor.h>
 #include <wlr/types/wlr_data_device.h>
 #include <wlr/types/wlr_output.h>
 #include <wlr/types/wlr_output_layout.h>
+#include <wlr/types/wlr_presentation_time.h>
 #include <wlr/types/wlr_xdg_shell.h>
 #include <wlr/types/wlr_xdg_decoration_v1.h>
 #include <wlr/types/wlr_seat.h>
@@ -59,14 +67,40 @@
 #define TB_GAP          2
 #define TB_BTN_MAX      42
 #define TB_BTN_HEIGHT   (BAR_HEIGHT - 6)
+#define TB_GRAPH_BAR    3  /* width of one sample in the cpu graph */
 
-#define UI_BATCH_MAX    512
+#define UI_BATCH_INIT   512   /* initial CPU batch capacity, grows as needed */
+#define UI_RING_BYTES   (1 << 20)  /* instance ring buffer, a few frames' worth of boxes */
+#define UI_TEX_SLOTS    8     /* texture units per batch; unit 0 is the glyph atlas */
 #define MAX_FIND_VIEWS  32
 #define NOTIF_WIDTH     300
 #define NOTIF_HEIGHT    60
 #define NOTIF_PADDING   10
 #define NOTIF_GAP       8
 #define MAX_NOTIFS      10
+#define WORKSPACES      9
+
+#define GRID_CELL       256   /* side of a spatial index cell in layout pixels */
+#define GRID_BUCKETS    64    /* hashed cells per workspace */
+
+#define BG_FPS_DEFAULT      30    /* plasma animation cap, RWM_BG_FPS (0 = every frame) */
+#define BG_CACHE_FPS_DEFAULT 10   /* same, when the plasma is rendered into a cache */
+#define BG_SCALE_DEFAULT    50    /* cache resolution in percent of the output, RWM_BG_SCALE */
+#define BG_MAX_RECTS        32    /* above this, the visible background is drawn as one box */
+#define FRAME_THROTTLE_MS   1000  /* frame callback period for views no output shows */
+#define RESIZE_TIMEOUT_MS   200   /* resize configure a client may leave unanswered */
+#define PROF_HISTORY        256   /* composited frames kept for the profile log */
+#define HUD_INTERVAL_MS     250   /* refresh period of the performance HUD */
+#define RENDER_HISTORY      32    /* frames the render time estimate is the maximum of */
+#define RENDER_MARGIN_US    1500  /* slack left before vblank for timer and commit jitter */
+#define HUD_WINDOW          60    /* frames the HUD averages over */
+#define HUD_LINES           5
+#define HUD_LINE_H          (FONT_SIZE + 6)
+#define HUD_WIDTH           340
+#define LATENCY_SAMPLES     128   /* commit-to-present samples kept per view */
+#define BENCH_INPUT_HZ      125   /* scripted pointer events per second (RWM_BENCH) */
+#define BENCH_HIST_US       10    /* frame time histogram resolution ... */
+#define BENCH_HIST_BUCKETS  10000 /* ... up to 100 ms */
 
 
 /* ========================================================================== */
@@ -81,6 +115,9 @@ enum box_icon    { ICON_NONE = 0, ICON_MINIMIZE = 1, ICON_MAXIMIZE = 2, ICON_CLO
 #define STYLE_TEXTURED 3
 #define STYLE_GLYPH    4
 enum view_state  { VIEW_NORMAL = 0, VIEW_MAXIMIZED, VIEW_FULLSCREEN, VIEW_MINIMIZED };
+enum bg_mode     { BG_ANIMATED = 0, BG_CACHED, BG_STATIC };
+enum prof_phase  { PHASE_BACKGROUND = 0, PHASE_VIEWS, PHASE_TASKBAR, PHASE_OVERLAYS,
+                   PHASE_FLUSH, PHASE_NIGHT, PHASE_COMMIT, PHASE_COUNT };
 
 /* ========================================================================== */
 /* Structs                                                                     */
@@ -89,10 +126,17 @@ enum view_state  { VIEW_NORMAL = 0, VIEW_MAXIMIZED, VIEW_FULLSCREEN, VIEW_MINIMI
 struct box_instance {
 	float box_xywh[4];       /* 16 bytes */
 	float data[4];    /* 16 bytes: RGBA as floats, or UV coords for glyphs */
-	uint8_t params[4];       /* 4 bytes: style, icon, pad, pad */
+	uint8_t params[4];       /* 4 bytes: style, icon, texture slot, pad */
 	uint8_t pad[4];          /* 4 bytes padding for alignment */
 }; /* 40 bytes */
 
+/* Retained box instances, recorded from the batch once and replayed with an offset */
+struct box_cache {
+	struct box_instance *boxes;
+	size_t n, cap;
+	bool valid;
+};
+
 struct glyph_info {
 	float u0, v0, u1, v1;
 	int bearing_x, bearing_y;
@@ -100,6 +144,30 @@ struct glyph_info {
 	int width, height;
 };
 
+/* One composited frame in the profile log */
+struct frame_profile {
+	uint64_t seq;              /* 0 = unused slot */
+	uint64_t start_ns;         /* CLOCK_MONOTONIC when the frame event arrived */
+	char output[16];
+	uint32_t cpu_us[PHASE_COUNT];
+	uint32_t cpu_total_us;
+	int32_t gpu_us;            /* -1 until the timer query resolves, or without one */
+	int32_t present_us;        /* commit to presentation, -1 until presented */
+	uint32_t delay_us;         /* frame event to start of rendering (RWM_RENDER_DELAY) */
+	bool missed;               /* discarded, or presented more than a refresh after commit */
+	unsigned draw_calls, instances, uploads;
+};
+
+/* Commit-to-present latency of a view's toplevel surface */
+struct view_latency {
+	uint64_t pending_ns;        /* oldest commit not yet rendered, 0 = none */
+	uint64_t inflight_ns;       /* that commit once rendered, until presented */
+	uint64_t inflight_commit;   /* srv->commit_id of the output commit showing it */
+	uint32_t samples[LATENCY_SAMPLES];  /* microseconds, newest at (count - 1) % LATENCY_SAMPLES */
+	uint64_t count;
+	uint32_t max_us;
+};
+
 struct view {
 	struct server *server;
 	struct wlr_xdg_toplevel *xdg_toplevel;
@@ -111,7 +179,15 @@ struct view {
 	enum view_state state;
 	pid_t pid;
 	char title[256];
+	uint32_t title_gen;         /* bumped by update_title */
 	struct wlr_xdg_toplevel_decoration_v1 *decoration;
+	struct view_latency latency;
+
+	/* Spatial index entry: the frame box and workspace the view is filed
+	   under, and its place in the stacking order (higher is on top) */
+	struct wlr_box index_box;
+	uint8_t index_ws;           /* 0 = not indexed */
+	uint64_t stack_seq;
 
 	struct wl_listener map;
 	struct wl_listener unmap;
@@ -121,12 +197,36 @@ struct view {
 	struct wl_listener request_resize;
 	struct wl_listener request_maximize;
 	struct wl_listener request_fullscreen;
+	struct wl_listener set_title;
 	struct wl_listener decoration_destroy;
 
 	int frame_w, frame_h, content_w, content_h;
+	struct wlr_box damaged_box; /* frame box at last damage, repainted on move */
+	bool occluded;              /* fully covered by opaque content in the last frame */
+	bool culled;                /* nothing uncovered inside the current frame's damage */
+	uint64_t frame_done_ns;     /* when frame callbacks were last sent */
+
+	/* Interactive resize: the configure in flight until the client commits
+	   it, and the content size the pointer asked for meanwhile */
+	uint32_t resize_serial;     /* 0 = none in flight */
+	uint64_t resize_sent_ns;
+	int resize_w, resize_h;     /* 0 = nothing queued */
+
+	/* Frame decoration instances, view-relative, and what they were built from */
+	struct box_cache frame_cache;
+	struct { int cw, ch; bool active; enum box_icon pressed; uint32_t title_gen; } frame_key;
+
+	struct wl_list link;         /* srv->views */
+	struct wl_list ws_link;      /* its workspace's views or minimized, empty while unmapped */
+	struct wl_list taskbar_link; /* its workspace's taskbar */
+};
 
-	struct wl_list link;
-	struct wl_list taskbar_link;
+/* Mapped views of one workspace. Everything that only concerns the shown
+   workspace walks these instead of every view. */
+struct workspace {
+	struct wl_list views;       /* not minimized, top of the stack first */
+	struct wl_list minimized;   /* most recently minimized first */
+	struct wl_list taskbar;     /* taskbar order, minimized views included */
 };
 
 static inline bool view_has_ssd(struct view *view) {
@@ -145,7 +245,45 @@ static inline struct frame_insets get_insets(struct view *view) {
 struct output {
 	struct wlr_output *wlr_output;
 	struct server *server;
+	int lx, ly;                  /* position in the output layout */
+	struct wlr_damage_ring damage_ring;
+	struct wlr_box cursor_box;   /* cursor trail drawn in the last frame */
+	double prev_cursor_x, prev_cursor_y;
+	bool scanout;                /* last frame showed a client buffer directly */
+	bool vrr_failed;             /* the backend rejected adaptive sync, don't retry */
+
+	/* Taskbar instances, output-relative, rebuilt after damage_taskbar */
+	struct box_cache taskbar_cache;
+	int taskbar_w, taskbar_h;
+	bool taskbar_dirty;
+
+	/* Background cache (BG_CACHED, BG_STATIC) */
+	GLuint bg_fbo, bg_tex;
+	int bg_w, bg_h;
+	uint32_t bg_generation;      /* srv->bg_generation the cache was rendered at */
+
+	/* Profiling of the last composited frame */
+	GLuint gpu_query;            /* GL_TIME_ELAPSED_EXT, 0 without the extension */
+	uint64_t gpu_query_frame;    /* profile seq waiting on gpu_query, 0 = none */
+	uint64_t present_frame;      /* profile seq waiting on the present event, 0 = none */
+	uint64_t present_commit;     /* srv->commit_id waiting on the present event, 0 = none */
+	uint32_t present_commit_seq;
+	uint64_t commit_ns;
+
+	/* Delayed composition: render times of the last frames, and the vblank
+	   they are scheduled against */
+	uint32_t render_us[RENDER_HISTORY];
+	unsigned render_idx;
+	uint32_t gpu_last_us;
+	uint64_t vblank_ns, frame_event_ns;
+	uint32_t refresh_ns;
+	int logged_delay_ms;
+	struct wl_event_source *delay_timer;
+	bool delay_armed;
+
+	struct wl_listener present;
 	struct wl_listener frame;
+	struct wl_listener needs_frame;
 	struct wl_listener request_state;
 	struct wl_listener destroy;
 	struct wl_list link;
@@ -199,19 +337,61 @@ struct server {
 	GLint bg_time_loc;
 	GLint bg_resolution_loc;
 	GLint bg_noise_offset_loc;
+	GLint bg_dither_loc;
 	GLuint bg_noise_tex;
 	struct timespec start_time;
+	float bg_time;             /* animation time of the current background frame */
+	float bg_noise_offset[2];
+	uint32_t bg_generation;    /* bumped on every animation step */
+	enum bg_mode bg_mode;
+	int bg_scale;
+
+	/* Background cache upscale */
+	GLuint bg_blit_prog;
+	GLint bg_blit_res_loc;
 
 	/* UI box shader (instanced) */
 	GLuint ui_prog;
 	GLuint ext_prog;
 	GLuint quad_vbo;         /* shared unit quad (0..1) */
-	GLuint inst_vbo;  /* per-box instance data */
-	GLint res_loc;
-	GLint ext_res_loc;
-	struct wlr_output *output;
-	struct box_instance batch[UI_BATCH_MAX];
-	size_t batch_n;
+	GLuint inst_vbo;  /* per-box instance data, written as a ring */
+	GLsizeiptr inst_ring_size, inst_ring_pos;
+	GLint res_loc, origin_loc;
+	GLint ext_res_loc, ext_origin_loc;
+	struct box_instance *batch;
+	size_t batch_n, batch_cap;
+	GLuint tex_slots[UI_TEX_SLOTS];  /* texture bound to each unit for the batch */
+	int tex_slot_n;
+
+	/* Per-frame render counters, logged at debug level */
+	struct {
+		unsigned draw_calls, instances, uploads;
+	} stats;
+
+	/* Frame profiling: the last PROF_HISTORY composited frames, and the HUD */
+	struct frame_profile profile[PROF_HISTORY];
+	uint64_t profile_seq;
+	bool gpu_timer, gpu_timer_checked;  /* GL_EXT_disjoint_timer_query */
+	bool hud_open;
+	char hud_text[HUD_LINES][64];
+	struct wl_event_source *hud_timer;
+	struct wl_event_source *sigusr1;   /* same as Super+Shift+P */
+
+	/* Presentation feedback; every output commit gets the next commit_id */
+	struct wlr_presentation *presentation;
+	uint64_t commit_id;
+
+	/* Benchmark mode (RWM_BENCH): a client command, scripted input and a report */
+	struct {
+		bool active;
+		pid_t pid;                 /* the client command, 0 once it exited */
+		struct wl_event_source *input_timer, *sigchld, *sigterm, *sigint;
+		uint32_t input_tick;
+		uint64_t start_ns;
+		struct rusage start_usage;
+		uint64_t frames, missed, commits, gpu_us, gpu_frames;
+		uint32_t hist[BENCH_HIST_BUCKETS];  /* CPU frame time in BENCH_HIST_US steps */
+	} bench;
 
 	/* Glyph atlas */
 	GLuint glyph_atlas;
@@ -229,9 +409,14 @@ struct server {
 	uint8_t workspace;
 	struct view *focused_view;
 
+	struct workspace workspaces[WORKSPACES + 1];  /* 1..WORKSPACES */
+
+	/* Mapped views by frame box, per workspace, see index_view */
+	struct view_bucket { struct view **views; int n, cap; } grid[WORKSPACES + 1][GRID_BUCKETS];
+	uint64_t stack_seq;
+
 	struct wlr_cursor *cursor;
 	struct wlr_xcursor_manager *xcursor_manager;
-	double prev_cursor_x, prev_cursor_y;
 
 	/* Cursor blur shader */
 	GLuint blur_prog;
@@ -251,9 +436,9 @@ struct server {
 
 	struct wl_listener new_output;
 	struct wl_listener backend_destroy;
-	struct wl_list outputs;
-	struct wl_list views;
-	struct wl_list taskbar_views;
+	struct wl_listener layout_change;
+	struct wl_list outputs;          /* oldest first; the first is the primary output */
+	struct wl_list views;            /* every mapped view, most recently raised first */
 
 	struct wlr_relative_pointer_manager_v1 *relative_pointer_manager;
 	struct wlr_pointer_constraints_v1 *pointer_constraints;
@@ -279,8 +464,32 @@ struct server {
 	/* Cached frame time */
 	struct timespec frame_time;
 
-	/* Cached sysinfo (updated by background thread) */
+	/* Frame scheduling: the background ticks at bg_fps while it is visible */
+	int bg_fps;
+	struct wl_event_source *bg_timer;
+	bool bg_timer_armed;
+
+	/* Adaptive sync for fullscreen views, RWM_VRR=off disables it */
+	bool vrr;
+	bool render_delay;  /* RWM_RENDER_DELAY=auto */
+
+	/* Frame callbacks for hidden views, see throttle_timer_handler */
+	struct wl_event_source *throttle_timer;
+	bool throttle_armed;
+
+	/* Pointer motion since the last hit test, see queue_cursor_motion */
+	bool motion_pending;
+	uint32_t motion_time;
+	bool pointer_frame_pending;  /* seat got pointer events since the last wl_pointer.frame */
+
+	/* Cached sysinfo (updated by background thread) and the status text drawn from it */
 	struct sysinfo cached_sysinfo;
+	struct wl_event_source *status_notify;  /* sysinfo_notify_fd */
+	struct wl_event_source *clock_timer;    /* fires as each minute starts */
+	char status[256];
+	int status_w;                /* measured width of status, -1 = not yet */
+	unsigned status_gen;         /* sysinfo_generation the text was built from */
+	bool cpu_graph;              /* RWM_CPU_GRAPH: utilisation graph left of the status */
 
 	/* Night mode (blue light filter) */
 	bool night_mode;
@@ -302,6 +511,10 @@ static const uint8_t COLOR_FRAME_ACTIVE[4] = {166, 166, 217, 255};
 
 /* Forward declarations */
 static struct notification *notification_at(struct server *srv, double cx, double cy);
+static void toggle_hud(struct server *srv);
+static void write_profile_log(struct server *srv);
+static void schedule_throttled_frames(struct server *srv);
+static void adjust_brightness(struct server *srv, int delta);
 
 static inline void listen(struct wl_listener *listener,
 		wl_notify_func_t handler, struct wl_signal *signal) {
@@ -314,6 +527,10 @@ static inline bool view_is_visible(const struct view *view, const struct server
 	return view->workspace == srv->workspace && view->state != VIEW_MINIMIZED;
 }
 
+static inline struct workspace *current_workspace(struct server *srv) {
+	return &srv->workspaces[srv->workspace];
+}
+
 /* ========================================================================== */
 /* Global server instance                                                      */
 /* ========================================================================== */
@@ -329,6 +546,7 @@ static const char bg_fragment_shader_src[] =
 	"uniform float u_time;\n"
 	"uniform vec2 u_resolution;\n"
 	"uniform vec2 u_noise_offset;\n"
+	"uniform float u_dither;\n"
 	"uniform sampler2D u_noise;\n"
 	"\n"
 	"void main() {\n"
@@ -347,30 +565,44 @@ static const char bg_fragment_shader_src[] =
 	"    float b = 0.30 + 0.25 * (v + 0.5);\n"
 	"\n"
 	"    vec3 n = texture2D(u_noise, gl_FragCoord.xy / 512.0 + u_noise_offset).rgb;\n"
-	"    vec3 dither = (n - 0.5) * (8.0 / 255.0);\n"
+	"    vec3 dither = (n - 0.5) * (8.0 / 255.0) * u_dither;\n"
 	"\n"
 	"    gl_FragColor = vec4(vec3(r, g, b) + dither, 1.0);\n"
 	"}\n";
 
+/* Upscale the cached background; dithered here at output resolution, with a
+   fixed pattern so the low update rate does not show as flicker */
+static const char bg_blit_fragment_shader_src[] =
+	"precision mediump float;\n"
+	"uniform vec2 u_resolution;\n"
+	"uniform sampler2D u_tex;\n"
+	"uniform sampler2D u_noise;\n"
+	"void main() {\n"
+	"    vec2 uv = gl_FragCoord.xy / u_resolution;\n"
+	"    vec3 n = texture2D(u_noise, gl_FragCoord.xy / 512.0).rgb;\n"
+	"    gl_FragColor = vec4(texture2D(u_tex, uv).rgb + (n - 0.5) * (8.0 / 255.0), 1.0);\n"
+	"}\n";
+
 static const char ui_vertex_shader_src[] =
 	"attribute vec2 a_pos;\n"
 	"attribute vec4 a_box;\n"
 	"attribute vec4 a_face_color;\n"
 	"attribute vec4 a_params;\n"
 	"uniform vec2 u_resolution;\n"
+	"uniform vec2 u_origin;\n"
 	"varying vec2 v_local_pos;\n"
 	"varying vec2 v_box_size;\n"
 	"varying vec4 v_face_color;\n"
-	"varying vec2 v_params;\n"
+	"varying vec3 v_params;\n"
 	"varying vec2 v_uv;\n"
 	"void main() {\n"
 	"    vec2 pixel = a_box.xy + a_pos * a_box.zw;\n"
-	"    vec2 clip = pixel / u_resolution * 2.0 - 1.0;\n"
+	"    vec2 clip = (pixel - u_origin) / u_resolution * 2.0 - 1.0;\n"
 	"    gl_Position = vec4(clip, 0.0, 1.0);\n"
 	"    v_local_pos = a_pos * a_box.zw;\n"
 	"    v_box_size = a_box.zw;\n"
 	"    v_face_color = a_face_color;\n"
-	"    v_params = a_params.xy * 255.0;\n"
+	"    v_params = a_params.xyz * 255.0;\n"
 	"    v_uv = a_pos;\n"
 	"}\n";
 
@@ -379,18 +611,34 @@ static const char ui_fragment_shader_src[] =
 	"varying vec2 v_local_pos;\n"
 	"varying vec2 v_box_size;\n"
 	"varying vec4 v_face_color;\n"
-	"varying vec2 v_params;\n"
+	"varying vec3 v_params;\n"
 	"varying vec2 v_uv;\n"
-	"uniform sampler2D u_tex;\n"
+	"uniform sampler2D u_tex0;\n"  /* glyph atlas */
+	"uniform sampler2D u_tex1;\n"
+	"uniform sampler2D u_tex2;\n"
+	"uniform sampler2D u_tex3;\n"
+	"uniform sampler2D u_tex4;\n"
+	"uniform sampler2D u_tex5;\n"
+	"uniform sampler2D u_tex6;\n"
+	"uniform sampler2D u_tex7;\n"
+	"vec4 sample_slot(float slot, vec2 uv) {\n"
+	"    if (slot < 1.5) return texture2D(u_tex1, uv);\n"
+	"    if (slot < 2.5) return texture2D(u_tex2, uv);\n"
+	"    if (slot < 3.5) return texture2D(u_tex3, uv);\n"
+	"    if (slot < 4.5) return texture2D(u_tex4, uv);\n"
+	"    if (slot < 5.5) return texture2D(u_tex5, uv);\n"
+	"    if (slot < 6.5) return texture2D(u_tex6, uv);\n"
+	"    return texture2D(u_tex7, uv);\n"
+	"}\n"
 	"void main() {\n"
 	"    float style = v_params.x;\n"
 	"    float icon = v_params.y;\n"
 	"    if (style > 3.5) {\n"
 	"        vec2 uv = mix(v_face_color.xy, v_face_color.zw, v_uv);\n"
-	"        gl_FragColor = vec4(0.0, 0.0, 0.0, texture2D(u_tex, uv).r);\n"
+	"        gl_FragColor = vec4(0.0, 0.0, 0.0, texture2D(u_tex0, uv).r);\n"
 	"        return;\n"
 	"    }\n"
-	"    if (style > 2.5) { gl_FragColor = texture2D(u_tex, v_uv); return; }\n"
+	"    if (style > 2.5) { gl_FragColor = sample_slot(v_params.z, v_uv); return; }\n"
 	"    float x = v_local_pos.x, y = v_local_pos.y;\n"
 	"    float w = v_box_size.x, h = v_box_size.y;\n"
 	"    vec4 face = v_face_color;\n"
@@ -482,6 +730,7 @@ static const char blur_fragment_shader_src[] =
 static void update_title(struct view *view) {
 	const char *t = view->xdg_toplevel->title ? view->xdg_toplevel->title : "";
 	snprintf(view->title, sizeof(view->title), "%s [%d]", t, view->pid);
+	view->title_gen++;
 }
 
 static inline struct wlr_surface *get_surface(struct view *view) {
@@ -507,6 +756,54 @@ static inline void get_content_pos(struct view *view, int *x, int *y) {
 	*y = view->y + fi.top;
 }
 
+static void update_geometry(struct view *view) {
+	struct wlr_box geo = get_geometry(view);
+	struct frame_insets fi = get_insets(view);
+	int cw = view->target_width > geo.width ? view->target_width : geo.width;
+	int ch = view->target_height > geo.height ? view->target_height : geo.height;
+	view->content_w = cw;
+	view->content_h = ch;
+	view->frame_w = cw + fi.left + fi.right;
+	view->frame_h = ch + fi.top + fi.bottom;
+}
+
+static int env_int(const char *name, int fallback, int min, int max) {
+	const char *str = getenv(name);
+	if (!str || !*str) return fallback;
+	char *end = NULL;
+	long val = strtol(str, &end, 10);
+	if (*end || val < min || val > max) {
+		wlr_log(WLR_ERROR, "Ignoring %s=%s (expected %d..%d)", name, str, min, max);
+		return fallback;
+	}
+	return (int)val;
+}
+
+static inline uint64_t timespec_to_ns(const struct timespec *ts) {
+	return (uint64_t)ts->tv_sec * 1000000000u + (uint64_t)ts->tv_nsec;
+}
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return timespec_to_ns(&ts);
+}
+
+/* RWM_HEADLESS: comma-separated output sizes, e.g. "1920x1080,1280x720";
+   anything that is not a size gets 1920x1080 */
+static void add_headless_outputs(struct server *srv, const char *spec) {
+	const char *p = spec;
+	do {
+		unsigned int w = 0, h = 0;
+		if (sscanf(p, "%ux%u", &w, &h) != 2 || !w || !h || w > 16384 || h > 16384) {
+			w = 1920;
+			h = 1080;
+		}
+		wlr_headless_add_output(srv->backend, w, h);
+		p = strchr(p, ',');
+	} while (p++);
+}
+
 static void spawn(const char *cmd) {
 	if (fork() == 0) {
 		sigset_t set;
@@ -518,6 +815,377 @@ static void spawn(const char *cmd) {
 	}
 }
 
+/* The first output added hosts the notifications and the find overlay */
+static struct output *primary_output(struct server *srv) {
+	if (wl_list_empty(&srv->outputs)) return NULL;
+	struct output *output = wl_container_of(srv->outputs.next, output, link);
+	return output;
+}
+
+static struct output *output_at(struct server *srv, double lx, double ly) {
+	struct wlr_output *wlr_output = wlr_output_layout_output_at(srv->output_layout, lx, ly);
+	return wlr_output ? wlr_output->data : primary_output(srv);
+}
+
+/* The output under the center of a view's frame */
+static struct output *view_output(struct view *view) {
+	update_geometry(view);
+	return output_at(view->server, view->x + view->frame_w / 2.0, view->y + view->frame_h / 2.0);
+}
+
+static inline struct wlr_box output_box(const struct output *output) {
+	return (struct wlr_box){ output->lx, output->ly, output->wlr_output->width, output->wlr_output->height };
+}
+
+/* The focused view, if it is fullscreen on this output */
+static struct view *fullscreen_view(struct server *srv, struct output *output) {
+	struct view *view = srv->focused_view;
+	if (!view || view->state != VIEW_FULLSCREEN || !view_is_visible(view, srv) ||
+			view_output(view) != output)
+		return NULL;
+	return view;
+}
+
+/* Each output has a taskbar, hidden while the focused view is fullscreen on it */
+static bool taskbar_visible(struct server *srv, struct output *output) {
+	return !fullscreen_view(srv, output);
+}
+
+/* Layout area of an output above its taskbar */
+static inline struct wlr_box usable_area(const struct output *output) {
+	struct wlr_box box = output_box(output);
+	box.height -= BAR_HEIGHT;
+	return box;
+}
+
+/* ========================================================================== */
+/* Spatial index                                                               */
+/* ========================================================================== */
+
+/* Hit testing looks at the views filed under the cell of the point instead of
+   every view. Cells are hashed into a fixed number of buckets per workspace;
+   views from colliding cells only cost a box test. */
+
+static inline bool box_equal(const struct wlr_box *a, const struct wlr_box *b) {
+	return a->x == b->x && a->y == b->y && a->width == b->width && a->height == b->height;
+}
+
+static inline int grid_cell(int v) {
+	return v >= 0 ? v / GRID_CELL : -((GRID_CELL - 1 - v) / GRID_CELL);
+}
+
+static inline unsigned grid_bucket(int cx, int cy) {
+	return ((unsigned)cx * 73856093u ^ (unsigned)cy * 19349663u) % GRID_BUCKETS;
+}
+
+/* Visit each bucket a box covers once; a box spanning more cells than there
+   are buckets covers all of them */
+static void grid_buckets(const struct wlr_box *box, bool hit[GRID_BUCKETS]) {
+	memset(hit, 0, GRID_BUCKETS * sizeof(*hit));
+	int x0 = grid_cell(box->x), x1 = grid_cell(box->x + box->width - 1);
+	int y0 = grid_cell(box->y), y1 = grid_cell(box->y + box->height - 1);
+	if ((long)(x1 - x0 + 1) * (y1 - y0 + 1) >= GRID_BUCKETS) {
+		memset(hit, 1, GRID_BUCKETS * sizeof(*hit));
+		return;
+	}
+	for (int cy = y0; cy <= y1; cy++)
+		for (int cx = x0; cx <= x1; cx++)
+			hit[grid_bucket(cx, cy)] = true;
+}
+
+static void unindex_view(struct view *view) {
+	if (!view->index_ws) return;
+	struct view_bucket *grid = view->server->grid[view->index_ws];
+	bool hit[GRID_BUCKETS];
+	grid_buckets(&view->index_box, hit);
+	for (int i = 0; i < GRID_BUCKETS; i++) {
+		if (!hit[i]) continue;
+		struct view_bucket *b = &grid[i];
+		for (int j = 0; j < b->n; j++) {
+			if (b->views[j] != view) continue;
+			b->views[j] = b->views[--b->n];
+			break;
+		}
+	}
+	view->index_ws = 0;
+}
+
+/* File a mapped view under its current frame box and workspace. Moves,
+   resizes and state changes all go through damage_view, which calls this. */
+static void index_view(struct view *view) {
+	if (!get_surface(view)->mapped) return;
+	int fw, fh;
+	get_frame_size(view, &fw, &fh);
+	struct wlr_box box = { view->x, view->y, fw > 0 ? fw : 1, fh > 0 ? fh : 1 };
+	if (view->index_ws == view->workspace && box_equal(&box, &view->index_box)) return;
+	unindex_view(view);
+
+	struct view_bucket *grid = view->server->grid[view->workspace];
+	bool hit[GRID_BUCKETS];
+	grid_buckets(&box, hit);
+	for (int i = 0; i < GRID_BUCKETS; i++) {
+		if (!hit[i]) continue;
+		struct view_bucket *b = &grid[i];
+		if (b->n == b->cap) {
+			int cap = b->cap ? b->cap * 2 : 8;
+			struct view **views = realloc(b->views, (size_t)cap * sizeof(*views));
+			if (!views) continue;
+			b->views = views;
+			b->cap = cap;
+		}
+		b->views[b->n++] = view;
+	}
+	view->index_box = box;
+	view->index_ws = view->workspace;
+}
+
+static void free_grid(struct server *srv) {
+	for (int ws = 0; ws <= WORKSPACES; ws++)
+		for (int i = 0; i < GRID_BUCKETS; i++)
+			free(srv->grid[ws][i].views);
+}
+
+/* ========================================================================== */
+/* Damage tracking                                                             */
+/* ========================================================================== */
+
+/* Boxes passed to damage_output_* are in output coordinates, everything else
+   (views, cursor, damage_box, damage_region) in layout coordinates. */
+
+static inline void output_add_damage(struct output *output, const struct wlr_box *box) {
+	if (box->width > 0 && box->height > 0)
+		wlr_damage_ring_add_box(&output->damage_ring, box);
+}
+
+static void damage_output_box(struct output *output, const struct wlr_box *box) {
+	if (box->width <= 0 || box->height <= 0) return;
+	wlr_damage_ring_add_box(&output->damage_ring, box);
+	wlr_output_schedule_frame(output->wlr_output);
+}
+
+static void damage_output_whole(struct output *output) {
+	struct wlr_box box = { 0, 0, output->wlr_output->width, output->wlr_output->height };
+	damage_output_box(output, &box);
+}
+
+static void damage_box(struct server *srv, const struct wlr_box *box) {
+	struct output *output = NULL;
+	wl_list_for_each(output, &srv->outputs, link) {
+		struct wlr_box bounds = { 0, 0, output->wlr_output->width, output->wlr_output->height };
+		struct wlr_box local = { box->x - output->lx, box->y - output->ly, box->width, box->height };
+		struct wlr_box clipped;
+		if (wlr_box_intersection(&clipped, &local, &bounds))
+			damage_output_box(output, &clipped);
+	}
+}
+
+static void damage_region(struct server *srv, const pixman_region32_t *region) {
+	if (!pixman_region32_not_empty(region)) return;
+	struct output *output = NULL;
+	wl_list_for_each(output, &srv->outputs, link) {
+		pixman_region32_t local;
+		pixman_region32_init(&local);
+		pixman_region32_copy(&local, region);
+		pixman_region32_translate(&local, -output->lx, -output->ly);
+		pixman_region32_intersect_rect(&local, &local, 0, 0,
+			(unsigned)output->wlr_output->width, (unsigned)output->wlr_output->height);
+		if (pixman_region32_not_empty(&local)) {
+			wlr_damage_ring_add(&output->damage_ring, &local);
+			wlr_output_schedule_frame(output->wlr_output);
+		}
+		pixman_region32_fini(&local);
+	}
+}
+
+static void damage_whole(struct server *srv) {
+	struct output *output = NULL;
+	wl_list_for_each(output, &srv->outputs, link) {
+		output->taskbar_dirty = true;
+		damage_output_whole(output);
+	}
+}
+
+/* Request a frame without damage, e.g. so clients get their frame callbacks */
+static void schedule_frames(struct server *srv) {
+	struct output *output = NULL;
+	wl_list_for_each(output, &srv->outputs, link)
+		wlr_output_schedule_frame(output->wlr_output);
+}
+
+/* A hidden taskbar is only marked dirty, so the status text ticking doesn't
+   force frames under a fullscreen view */
+static void damage_taskbar(struct server *srv) {
+	struct output *output = NULL;
+	wl_list_for_each(output, &srv->outputs, link) {
+		struct wlr_output *o = output->wlr_output;
+		output->taskbar_dirty = true;
+		if (!taskbar_visible(srv, output)) continue;
+		struct wlr_box box = { 0, o->height - BAR_HEIGHT, o->width, BAR_HEIGHT };
+		damage_output_box(output, &box);
+	}
+}
+
+static void damage_notifications(struct server *srv) {
+	struct output *output = primary_output(srv);
+	if (!output) return;
+	struct wlr_box box = { output->wlr_output->width - NOTIF_WIDTH - NOTIF_PADDING, 0,
+		NOTIF_WIDTH, NOTIF_PADDING + MAX_NOTIFS * (NOTIF_HEIGHT + NOTIF_GAP) };
+	damage_output_box(output, &box);
+}
+
+/* Damage the view frame at its current position and wherever it was last damaged,
+   so a single call after a move, resize or state change repaints both areas. */
+static void damage_view(struct view *view) {
+	update_geometry(view);
+	struct wlr_box box = { view->x, view->y, view->frame_w, view->frame_h };
+	damage_box(view->server, &view->damaged_box);
+	if (!box_equal(&box, &view->damaged_box))
+		damage_box(view->server, &box);
+	view->damaged_box = box;
+	index_view(view);
+}
+
+static void damage_surface_iterator(struct wlr_surface *surface, int sx, int sy, void *data) {
+	struct view *view = data;
+	struct wlr_box geo = get_geometry(view);
+	int cx, cy;
+	get_content_pos(view, &cx, &cy);
+
+	pixman_region32_t damage;
+	pixman_region32_init(&damage);
+	wlr_surface_get_effective_damage(surface, &damage);
+	pixman_region32_translate(&damage, cx + sx - geo.x, cy + sy - geo.y);
+	damage_region(view->server, &damage);
+	pixman_region32_fini(&damage);
+}
+
+/* Damage only what the client reported as changed in its surface tree */
+static void damage_view_surfaces(struct view *view) {
+	wlr_xdg_surface_for_each_surface(view->xdg_toplevel->base, damage_surface_iterator, view);
+}
+
+struct region_data { struct view *view; pixman_region32_t *region; };
+
+static void opaque_surface_iterator(struct wlr_surface *surface, int sx, int sy, void *data) {
+	struct region_data *rd = data;
+	struct wlr_box geo = get_geometry(rd->view);
+	int cx, cy;
+	get_content_pos(rd->view, &cx, &cy);
+
+	pixman_region32_t opaque;
+	pixman_region32_init(&opaque);
+	pixman_region32_copy(&opaque, &surface->opaque_region);
+	pixman_region32_translate(&opaque, cx + sx - geo.x, cy + sy - geo.y);
+	pixman_region32_union(rd->region, rd->region, &opaque);
+	pixman_region32_fini(&opaque);
+}
+
+/* Add what the view paints fully opaque: its server-side frame and the
+   opaque regions its surfaces declare */
+static void add_view_opaque(struct view *view, pixman_region32_t *region) {
+	update_geometry(view);
+	if (view->frame_h > view->content_h) {
+		struct frame_insets fi = get_insets(view);
+		int x = view->x, y = view->y, w = view->frame_w, h = view->frame_h;
+		pixman_region32_union_rect(region, region, x, y, (unsigned)w, (unsigned)fi.top);
+		pixman_region32_union_rect(region, region, x, y + h - fi.bottom, (unsigned)w, (unsigned)fi.bottom);
+		pixman_region32_union_rect(region, region, x, y, (unsigned)fi.left, (unsigned)h);
+		pixman_region32_union_rect(region, region, x + w - fi.right, y, (unsigned)fi.right, (unsigned)h);
+	}
+	struct region_data rd = { view, region };
+	wlr_xdg_surface_for_each_surface(view->xdg_toplevel->base, opaque_surface_iterator, &rd);
+}
+
+static void bounds_surface_iterator(struct wlr_surface *surface, int sx, int sy, void *data) {
+	struct region_data *rd = data;
+	struct wlr_box geo = get_geometry(rd->view);
+	int cx, cy;
+	get_content_pos(rd->view, &cx, &cy);
+	pixman_region32_union_rect(rd->region, rd->region, cx + sx - geo.x, cy + sy - geo.y,
+		(unsigned)surface->current.width, (unsigned)surface->current.height);
+}
+
+/* Everything the view draws: frame plus all surfaces, popups included */
+static void add_view_bounds(struct view *view, pixman_region32_t *region) {
+	update_geometry(view);
+	pixman_region32_union_rect(region, region, view->x, view->y,
+		(unsigned)view->frame_w, (unsigned)view->frame_h);
+	struct region_data rd = { view, region };
+	wlr_xdg_surface_for_each_surface(view->xdg_toplevel->base, bounds_surface_iterator, &rd);
+}
+
+static void add_taskbar_opaque(struct server *srv, struct output *output, pixman_region32_t *region) {
+	if (!taskbar_visible(srv, output)) return;
+	struct wlr_output *o = output->wlr_output;
+	pixman_region32_union_rect(region, region, output->lx, output->ly + o->height - BAR_HEIGHT,
+		(unsigned)o->width, BAR_HEIGHT);
+}
+
+/* Layout area painted fully opaque in the output's next frame */
+static void collect_opaque_region(struct server *srv, struct output *output, pixman_region32_t *region) {
+	add_taskbar_opaque(srv, output, region);
+	struct view *view = NULL;
+	wl_list_for_each(view, &current_workspace(srv)->views, ws_link)
+		add_view_opaque(view, region);
+}
+
+/* Damage only the part of the background that is not covered, so an animation
+   step does not repaint the windows on top of it. Outputs with a fullscreen
+   view are left alone, as in background_animating: gaps in a translucent
+   client must not pace an adaptive sync output at the background's rate. */
+static void damage_background(struct server *srv) {
+	struct output *output = NULL;
+	wl_list_for_each(output, &srv->outputs, link) {
+		if (fullscreen_view(srv, output)) continue;
+		struct wlr_output *o = output->wlr_output;
+		pixman_region32_t opaque, region;
+		pixman_region32_init(&opaque);
+		pixman_region32_init_rect(&region, output->lx, output->ly, (unsigned)o->width, (unsigned)o->height);
+		collect_opaque_region(srv, output, &opaque);
+		pixman_region32_subtract(&region, &region, &opaque);
+		pixman_region32_translate(&region, -output->lx, -output->ly);
+		if (pixman_region32_not_empty(&region)) {
+			wlr_damage_ring_add(&output->damage_ring, &region);
+			wlr_output_schedule_frame(o);
+		}
+		pixman_region32_fini(&region);
+		pixman_region32_fini(&opaque);
+	}
+}
+
+/* Walk the views front to back, accumulating the opaque area above each one.
+   A view with nothing left uncovered is occluded; one with nothing uncovered
+   inside this frame's damage, or off this output, is culled from the frame.
+   Occlusion is recorded on the view's own output only. On return, opaque holds
+   everything covered in output coordinates, for clipping the background. */
+static void cull_views(struct server *srv, struct output *output,
+		const pixman_region32_t *damage, pixman_region32_t *opaque) {
+	struct wlr_output *o = output->wlr_output;
+	pixman_region32_t layout_damage;
+	pixman_region32_init(&layout_damage);
+	pixman_region32_copy(&layout_damage, damage);
+	pixman_region32_translate(&layout_damage, output->lx, output->ly);
+	add_taskbar_opaque(srv, output, opaque);
+
+	struct view *view = NULL;
+	wl_list_for_each(view, &current_workspace(srv)->views, ws_link) {
+		pixman_region32_t visible;
+		pixman_region32_init(&visible);
+		add_view_bounds(view, &visible);
+		pixman_region32_intersect_rect(&visible, &visible, output->lx, output->ly,
+			(unsigned)o->width, (unsigned)o->height);
+		pixman_region32_subtract(&visible, &visible, opaque);
+		if (view_output(view) == output)
+			view->occluded = !pixman_region32_not_empty(&visible);
+		pixman_region32_intersect(&visible, &visible, &layout_damage);
+		view->culled = !pixman_region32_not_empty(&visible);
+		pixman_region32_fini(&visible);
+		add_view_opaque(view, opaque);
+	}
+	pixman_region32_fini(&layout_damage);
+	pixman_region32_translate(opaque, -output->lx, -output->ly);
+}
+
 
 /* ========================================================================== */
 /* Text rendering (FreeType)                                                   */
@@ -648,6 +1316,7 @@ static void init_background_shader(struct server *srv) {
 	srv->bg_time_loc = glGetUniformLocation(srv->bg_prog, "u_time");
 	srv->bg_resolution_loc = glGetUniformLocation(srv->bg_prog, "u_resolution");
 	srv->bg_noise_offset_loc = glGetUniformLocation(srv->bg_prog, "u_noise_offset");
+	srv->bg_dither_loc = glGetUniformLocation(srv->bg_prog, "u_dither");
 
 	if (!srv->quad_vbo) {
 		static const float quad[] = { 0,0, 1,0, 0,1, 1,1 };
@@ -678,23 +1347,33 @@ static void init_background_shader(struct server *srv) {
 	clock_gettime(CLOCK_MONOTONIC, &srv->start_time);
 }
 
-static void render_shader_background(struct server *srv, int width, int height) {
+/* Step the plasma to the current time. Partial repaints between steps reuse the
+   same time and dither offset so they blend seamlessly with the rest of the frame. */
+static void advance_background(struct server *srv) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	srv->bg_time = fmodf((float)(now.tv_sec - srv->start_time.tv_sec) +
+		(float)(now.tv_nsec - srv->start_time.tv_nsec) / 1e9f, 1000.0f);
+	int rx = rand(), ry = rand();
+	srv->bg_noise_offset[0] = (float)rx / (float)RAND_MAX;
+	srv->bg_noise_offset[1] = (float)ry / (float)RAND_MAX;
+	srv->bg_generation++;
+}
+
+/* Bind the plasma shader for a width x height target; the caller draws the quad */
+static bool use_background_shader(struct server *srv, int width, int height, float dither) {
 	if (!srv->bg_prog) {
 		init_background_shader(srv);
-		if (!srv->bg_prog) return;
+		if (!srv->bg_prog) return false;
 	}
 
-	float elapsed = fmodf((float)(srv->frame_time.tv_sec - srv->start_time.tv_sec) +
-		(float)(srv->frame_time.tv_nsec - srv->start_time.tv_nsec) / 1e9f, 1000.0f);
-
-	glDisable(GL_SCISSOR_TEST);
 	glDisable(GL_BLEND);
 	glViewport(0, 0, width, height);
 	glUseProgram(srv->bg_prog);
-	glUniform1f(srv->bg_time_loc, elapsed);
+	glUniform1f(srv->bg_time_loc, srv->bg_time);
 	glUniform2f(srv->bg_resolution_loc, (float)width, (float)height);
-	int rx = rand(), ry = rand();
-	glUniform2f(srv->bg_noise_offset_loc, (float)rx / (float)RAND_MAX, (float)ry / (float)RAND_MAX);
+	glUniform2f(srv->bg_noise_offset_loc, srv->bg_noise_offset[0], srv->bg_noise_offset[1]);
+	glUniform1f(srv->bg_dither_loc, dither);
 
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, srv->bg_noise_tex);
@@ -702,7 +1381,124 @@ static void render_shader_background(struct server *srv, int width, int height)
 	glBindBuffer(GL_ARRAY_BUFFER, srv->quad_vbo);
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, NULL);
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	return true;
+}
+
+/* Re-render the output's background cache if the plasma stepped or the output
+   was resized. Returns false if no cache is available (FBO unsupported). */
+static bool update_background_cache(struct server *srv, struct output *output) {
+	int w = output->wlr_output->width * srv->bg_scale / 100;
+	int h = output->wlr_output->height * srv->bg_scale / 100;
+	if (w < 1) w = 1;
+	if (h < 1) h = 1;
+
+	bool realloc = !output->bg_tex || w != output->bg_w || h != output->bg_h;
+	if (!realloc && output->bg_generation == srv->bg_generation)
+		return true;
+
+	GLint prev_fbo = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prev_fbo);
+
+	if (realloc) {
+		if (!output->bg_tex) {
+			glGenTextures(1, &output->bg_tex);
+			glGenFramebuffers(1, &output->bg_fbo);
+		}
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, output->bg_tex);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindFramebuffer(GL_FRAMEBUFFER, output->bg_fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, output->bg_tex, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			wlr_log(WLR_ERROR, "Background cache framebuffer incomplete, drawing directly");
+			glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)prev_fbo);
+			glDeleteFramebuffers(1, &output->bg_fbo);
+			glDeleteTextures(1, &output->bg_tex);
+			output->bg_fbo = output->bg_tex = 0;
+			srv->bg_mode = BG_ANIMATED;
+			return false;
+		}
+		output->bg_w = w;
+		output->bg_h = h;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, output->bg_fbo);
+	glDisable(GL_SCISSOR_TEST);
+	if (use_background_shader(srv, w, h, 0.0f)) {
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+		srv->stats.draw_calls++;
+	}
+	glEnable(GL_SCISSOR_TEST);
+	glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)prev_fbo);
+	output->bg_generation = srv->bg_generation;
+	return true;
+}
+
+static void init_background_blit(struct server *srv) {
+	const char *attribs[] = { "a_pos" };
+	srv->bg_blit_prog = create_program(quad_vertex_shader_src, bg_blit_fragment_shader_src, attribs, 1);
+	if (!srv->bg_blit_prog) return;
+	srv->bg_blit_res_loc = glGetUniformLocation(srv->bg_blit_prog, "u_resolution");
+	glUseProgram(srv->bg_blit_prog);
+	glUniform1i(glGetUniformLocation(srv->bg_blit_prog, "u_tex"), 0);
+	glUniform1i(glGetUniformLocation(srv->bg_blit_prog, "u_noise"), 1);
+}
+
+/* Bind the cache upscale shader for the output; the caller draws the quad */
+static bool use_background_cache(struct server *srv, struct output *output) {
+	if (!srv->bg_blit_prog) {
+		init_background_blit(srv);
+		if (!srv->bg_blit_prog) return false;
+	}
+	struct wlr_output *wlr_output = output->wlr_output;
+
+	glDisable(GL_BLEND);
+	glViewport(0, 0, wlr_output->width, wlr_output->height);
+	glUseProgram(srv->bg_blit_prog);
+	glUniform2f(srv->bg_blit_res_loc, (float)wlr_output->width, (float)wlr_output->height);
+
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, srv->bg_noise_tex);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, output->bg_tex);
+
+	glBindBuffer(GL_ARRAY_BUFFER, srv->quad_vbo);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+	return true;
+}
+
+/* Nothing to animate for a static background, or while every enabled
+   output has a fullscreen view hiding it */
+static bool background_animating(struct server *srv) {
+	if (srv->bg_mode == BG_STATIC) return false;
+	struct output *output;
+	wl_list_for_each(output, &srv->outputs, link) {
+		if (output->wlr_output->enabled && !fullscreen_view(srv, output)) return true;
+	}
+	return false;
+}
+
+static int bg_timer_handler(void *data) {
+	struct server *srv = data;
+	srv->bg_timer_armed = false;
+	if (!background_animating(srv)) return 0;
+	advance_background(srv);
+	damage_background(srv);
+	return 0;
+}
+
+/* Arm the next background step. The frame it produces re-arms it, so ticking
+   stops on its own once the background is covered. */
+static void schedule_background(struct server *srv) {
+	if (!srv->bg_timer || srv->bg_fps <= 0 || srv->bg_timer_armed || !background_animating(srv))
+		return;
+	wl_event_source_timer_update(srv->bg_timer, 1000 / srv->bg_fps);
+	srv->bg_timer_armed = true;
 }
 
 static void init_night_shader(struct server *srv) {
@@ -726,6 +1522,7 @@ static void render_night_filter(struct server *srv, int width, int height) {
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, NULL);
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	srv->stats.draw_calls++;
 	glDisableVertexAttribArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
@@ -745,15 +1542,37 @@ static void init_ui_shader(struct server *srv) {
 	if (!srv->ui_prog) return;
 
 	srv->res_loc = glGetUniformLocation(srv->ui_prog, "u_resolution");
+	srv->origin_loc = glGetUniformLocation(srv->ui_prog, "u_origin");
+	glUseProgram(srv->ui_prog);
+	for (int i = 0; i < UI_TEX_SLOTS; i++) {
+		char name[16];
+		snprintf(name, sizeof(name), "u_tex%d", i);
+		glUniform1i(glGetUniformLocation(srv->ui_prog, name), i);
+	}
 
 	srv->ext_prog = create_program(ui_vertex_shader_src, ui_fragment_shader_external_src, attribs, 4);
-	if (srv->ext_prog)
+	if (srv->ext_prog) {
 		srv->ext_res_loc = glGetUniformLocation(srv->ext_prog, "u_resolution");
+		srv->ext_origin_loc = glGetUniformLocation(srv->ext_prog, "u_origin");
+	}
 
-	/* Dynamic instance data - pre-allocate for max batch size */
+	/* Instance ring: each flush appends its boxes, the storage is orphaned on wrap */
+	srv->inst_ring_size = UI_RING_BYTES;
+	srv->inst_ring_pos = 0;
 	glGenBuffers(1, &srv->inst_vbo);
 	glBindBuffer(GL_ARRAY_BUFFER, srv->inst_vbo);
-	glBufferData(GL_ARRAY_BUFFER, UI_BATCH_MAX * sizeof(struct box_instance), NULL, GL_STREAM_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, srv->inst_ring_size, NULL, GL_STREAM_DRAW);
+}
+
+/* Point the per-instance attributes at a batch starting at offset in inst_vbo */
+static void set_instance_offset(GLsizeiptr offset) {
+	#define S sizeof(struct box_instance)
+	#define O(f) ((void *)(offset + (GLsizeiptr)offsetof(struct box_instance, f)))
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, S, O(box_xywh));
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, S, O(data));
+	glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, S, O(params));
+	#undef O
+	#undef S
 }
 
 static void setup_ui_attributes(struct server *srv) {
@@ -764,35 +1583,82 @@ static void setup_ui_attributes(struct server *srv) {
 	glVertexAttribDivisor(0, 0);
 
 	glBindBuffer(GL_ARRAY_BUFFER, srv->inst_vbo);
-	#define S sizeof(struct box_instance)
-	#define O(f) ((void *)offsetof(struct box_instance, f))
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, S, O(box_xywh));
-	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, S, O(data));
-	glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, S, O(params));
-	#undef O
-	#undef S
+	set_instance_offset(0);
 	for (GLuint i = 1; i < 4; i++) glVertexAttribDivisor(i, 1);
 }
 
 static void flush_boxes(struct server *srv) {
 	if (!srv->batch_n) return;
 
-	/* Upload instance data (buffer already allocated) */
+	/* Append to the ring without synchronizing: the range was never written since
+	   the storage was last orphaned, so no queued draw can still be reading it */
+	GLsizeiptr bytes = (GLsizeiptr)(srv->batch_n * sizeof(struct box_instance));
 	glBindBuffer(GL_ARRAY_BUFFER, srv->inst_vbo);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)(srv->batch_n * sizeof(struct box_instance)),
-		srv->batch);
+	if (srv->inst_ring_pos + bytes > srv->inst_ring_size) {
+		while (bytes > srv->inst_ring_size)
+			srv->inst_ring_size *= 2;
+		glBufferData(GL_ARRAY_BUFFER, srv->inst_ring_size, NULL, GL_STREAM_DRAW);
+		srv->inst_ring_pos = 0;
+	}
+	GLsizeiptr offset = srv->inst_ring_pos;
+	void *dst = glMapBufferRange(GL_ARRAY_BUFFER, offset, bytes,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (dst) {
+		memcpy(dst, srv->batch, (size_t)bytes);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+	} else {
+		glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, srv->batch);
+	}
+	srv->inst_ring_pos += bytes;
+	set_instance_offset(offset);
 
 	/* Draw all boxes with one instanced call */
 	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)srv->batch_n);
+	srv->stats.uploads++;
+	srv->stats.draw_calls++;
+	srv->stats.instances += (unsigned)srv->batch_n;
 	srv->batch_n = 0;
 }
 
-static void queue_box(struct server *srv, int x, int y, int w, int h,
-		int style, const uint8_t *color, enum box_icon icon) {
-	if (srv->batch_n >= UI_BATCH_MAX)
+/* Next free instance in the CPU batch, growing it rather than flushing early */
+static struct box_instance *next_box(struct server *srv) {
+	if (srv->batch_n >= srv->batch_cap) {
+		size_t cap = srv->batch_cap ? srv->batch_cap * 2 : UI_BATCH_INIT;
+		struct box_instance *batch = realloc(srv->batch, cap * sizeof(*batch));
+		if (batch) {
+			srv->batch = batch;
+			srv->batch_cap = cap;
+		} else {
+			flush_boxes(srv);
+			if (!srv->batch_cap) return NULL;
+		}
+	}
+	return &srv->batch[srv->batch_n++];
+}
+
+/* Texture unit for a 2D texture in the current batch. Binds it to a free unit,
+   flushing first when all units are taken by textures of queued boxes. */
+static uint8_t bind_texture_slot(struct server *srv, GLuint tex) {
+	for (int i = 1; i < srv->tex_slot_n; i++)
+		if (srv->tex_slots[i] == tex) return (uint8_t)i;
+	if (srv->tex_slot_n >= UI_TEX_SLOTS) {
 		flush_boxes(srv);
+		srv->tex_slot_n = 1;
+	}
+	int slot = srv->tex_slot_n++;
+	srv->tex_slots[slot] = tex;
+	glActiveTexture(GL_TEXTURE0 + (GLenum)slot);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glActiveTexture(GL_TEXTURE0);
+	return (uint8_t)slot;
+}
 
-	struct box_instance *inst = &srv->batch[srv->batch_n++];
+static struct box_instance *queue_box(struct server *srv, int x, int y, int w, int h,
+		int style, const uint8_t *color, enum box_icon icon) {
+	struct box_instance *inst = next_box(srv);
+	if (!inst) return NULL;
 	inst->box_xywh[0] = (float)x;
 	inst->box_xywh[1] = (float)y;
 	inst->box_xywh[2] = (float)w;
@@ -809,6 +1675,47 @@ static void queue_box(struct server *srv, int x, int y, int w, int h,
 	} else {
 		inst->data[0] = inst->data[1] = inst->data[2] = inst->data[3] = 0;
 	}
+	return inst;
+}
+
+/* Keep the boxes queued since start, shifted by -ox,-oy. Returns false (and
+   drops the cache) if the batch was flushed in between. */
+static bool cache_record(struct server *srv, struct box_cache *cache, size_t start, int ox, int oy) {
+	cache->valid = false;
+	if (srv->batch_n < start) return false;
+	size_t n = srv->batch_n - start;
+	if (n > cache->cap) {
+		struct box_instance *boxes = realloc(cache->boxes, n * sizeof(*boxes));
+		if (!boxes) return false;
+		cache->boxes = boxes;
+		cache->cap = n;
+	}
+	for (size_t i = 0; i < n; i++) {
+		cache->boxes[i] = srv->batch[start + i];
+		cache->boxes[i].box_xywh[0] -= (float)ox;
+		cache->boxes[i].box_xywh[1] -= (float)oy;
+	}
+	cache->n = n;
+	cache->valid = true;
+	return true;
+}
+
+/* Move the boxes queued since start, e.g. from output to layout coordinates */
+static void shift_boxes(struct server *srv, size_t start, int dx, int dy) {
+	for (size_t i = start; i < srv->batch_n; i++) {
+		srv->batch[i].box_xywh[0] += (float)dx;
+		srv->batch[i].box_xywh[1] += (float)dy;
+	}
+}
+
+static void cache_replay(struct server *srv, const struct box_cache *cache, int ox, int oy) {
+	for (size_t i = 0; i < cache->n; i++) {
+		struct box_instance *inst = next_box(srv);
+		if (!inst) return;
+		*inst = cache->boxes[i];
+		inst->box_xywh[0] += (float)ox;
+		inst->box_xywh[1] += (float)oy;
+	}
 }
 
 static void draw_raised(struct server *srv, int x, int y, int w, int h,
@@ -841,9 +1748,8 @@ static int measure_text(const struct server *srv, const char *text, int max_widt
 
 static void draw_glyph(struct server *srv, int x, int y, int w, int h,
 		float u0, float v0, float u1, float v1) {
-	if (srv->batch_n >= UI_BATCH_MAX)
-		flush_boxes(srv);
-	struct box_instance *inst = &srv->batch[srv->batch_n++];
+	struct box_instance *inst = next_box(srv);
+	if (!inst) return;
 	inst->box_xywh[0] = (float)x;
 	inst->box_xywh[1] = (float)y;
 	inst->box_xywh[2] = (float)w;
@@ -881,17 +1787,44 @@ static int draw_text(struct server *srv, const char *text, int max_width, int x,
 /* View management                                                             */
 /* ========================================================================== */
 
-static void set_view_state(struct view *view, enum view_state new_state) {
-	view->state = new_state;
-	wlr_xdg_toplevel_set_maximized(view->xdg_toplevel, new_state == VIEW_MAXIMIZED);
-	wlr_xdg_toplevel_set_fullscreen(view->xdg_toplevel, new_state == VIEW_FULLSCREEN);
+/* Put a mapped view on top of its workspace's stack, or of its minimized set */
+static void stack_view(struct view *view) {
+	struct workspace *ws = &view->server->workspaces[view->workspace];
+	wl_list_remove(&view->ws_link);
+	wl_list_insert(view->state == VIEW_MINIMIZED ? &ws->minimized : &ws->views, &view->ws_link);
 }
 
-static void detach_view(struct server *srv, const struct view *view) {
-	if (srv->grabbed_view == view)
-		srv->grabbed_view = NULL;
-	if (srv->focused_view == view)
-		srv->focused_view = NULL;
+static void raise_view(struct view *view) {
+	struct server *srv = view->server;
+	wl_list_remove(&view->link);
+	wl_list_insert(&srv->views, &view->link);
+	stack_view(view);
+	view->stack_seq = ++srv->stack_seq;
+}
+
+static void move_view_to_workspace(struct view *view, uint8_t ws) {
+	view->workspace = ws;
+	stack_view(view);
+	wl_list_remove(&view->taskbar_link);
+	wl_list_insert(view->server->workspaces[ws].taskbar.prev, &view->taskbar_link);
+}
+
+static void set_view_state(struct view *view, enum view_state new_state) {
+	bool was_minimized = view->state == VIEW_MINIMIZED;
+	view->state = new_state;
+	if (was_minimized != (new_state == VIEW_MINIMIZED) && !wl_list_empty(&view->ws_link))
+		stack_view(view);
+	wlr_xdg_toplevel_set_maximized(view->xdg_toplevel, new_state == VIEW_MAXIMIZED);
+	wlr_xdg_toplevel_set_fullscreen(view->xdg_toplevel, new_state == VIEW_FULLSCREEN);
+	damage_view(view);
+	damage_taskbar(view->server);
+}
+
+static void detach_view(struct server *srv, const struct view *view) {
+	if (srv->grabbed_view == view)
+		srv->grabbed_view = NULL;
+	if (srv->focused_view == view)
+		srv->focused_view = NULL;
 	if (srv->pressed.type == PRESSED_TITLE_BUTTON && srv->pressed.title.view == view)
 		srv->pressed.type = PRESSED_NONE;
 	if (srv->pressed.type == PRESSED_TASKBAR && srv->pressed.tb.view == view)
@@ -901,8 +1834,10 @@ static void detach_view(struct server *srv, const struct view *view) {
 static void focus_view(struct view *view, struct wlr_surface *surface) {
 	struct server *srv = view->server;
 	struct wlr_seat *seat = srv->seat;
-	if (srv->focused_view && srv->focused_view != view)
+	if (srv->focused_view && srv->focused_view != view) {
 		wlr_xdg_toplevel_set_activated(srv->focused_view->xdg_toplevel, false);
+		damage_view(srv->focused_view);
+	}
 
 	/* Deactivate pointer constraint when focus changes to a different surface */
 	if (srv->active_constraint && srv->active_constraint->surface != surface) {
@@ -912,11 +1847,12 @@ static void focus_view(struct view *view, struct wlr_surface *surface) {
 		srv->active_constraint = NULL;
 	}
 
-	wl_list_remove(&view->link);
-	wl_list_insert(&srv->views, &view->link);
+	raise_view(view);
 
 	wlr_xdg_toplevel_set_activated(view->xdg_toplevel, true);
 	srv->focused_view = view;
+	damage_view(view);
+	damage_taskbar(srv);
 
 	struct wlr_keyboard *kb = wlr_seat_get_keyboard(seat);
 	if (kb) {
@@ -925,20 +1861,20 @@ static void focus_view(struct view *view, struct wlr_surface *surface) {
 }
 
 static void focus_top_view(struct server *srv) {
-	struct view *next = NULL;
-	wl_list_for_each(next, &srv->views, link) {
-		if (!view_is_visible(next, srv)) continue;
+	struct wl_list *views = &current_workspace(srv)->views;
+	if (!wl_list_empty(views)) {
+		struct view *next = wl_container_of(views->next, next, ws_link);
 		focus_view(next, get_surface(next));
 		return;
 	}
 	srv->focused_view = NULL;
 	wlr_seat_keyboard_clear_focus(srv->seat);
+	damage_taskbar(srv);
 }
 
 static void focus_last_window(struct server *srv) {
 	struct view *view = NULL;
-	wl_list_for_each(view, &srv->views, link) {
-		if (!view_is_visible(view, srv)) continue;
+	wl_list_for_each(view, &current_workspace(srv)->views, ws_link) {
 		if (view != srv->focused_view) {
 			focus_view(view, get_surface(view));
 			return;
@@ -953,6 +1889,15 @@ static void defocus_view(struct server *srv, const struct view *view) {
 	focus_top_view(srv);
 }
 
+static void switch_workspace(struct server *srv, uint8_t ws) {
+	srv->workspace = ws;
+	srv->find_open = false;
+	focus_top_view(srv);
+	damage_whole(srv);
+	/* Views left behind may still wait for a frame callback */
+	schedule_throttled_frames(srv);
+}
+
 static void save_geometry(struct view *view) {
 	if (view->state != VIEW_NORMAL) return;
 	struct wlr_box geo = get_geometry(view);
@@ -971,12 +1916,6 @@ static void restore_geometry(struct view *view) {
 	wlr_xdg_toplevel_set_size(view->xdg_toplevel, view->saved_width, view->saved_height);
 }
 
-/* Get usable screen area (excluding taskbar) */
-static inline void get_usable_area(const struct server *srv, int *w, int *h) {
-	*w = srv->output->width;
-	*h = srv->output->height - BAR_HEIGHT;
-}
-
 /* Position and size a view to fill a screen-space rectangle, subtracting
    frame insets so the outer edge (frame or client CSD) fits the rect. */
 static void place_view(struct view *view, int x, int y, int w, int h) {
@@ -986,25 +1925,29 @@ static void place_view(struct view *view, int x, int y, int w, int h) {
 	view->target_width = w - fi.left - fi.right;
 	view->target_height = h - fi.top - fi.bottom;
 	wlr_xdg_toplevel_set_size(view->xdg_toplevel, view->target_width, view->target_height);
+	damage_view(view);
 }
 
-static inline void snap_view(struct view *view, int x, int y, int w, int h) {
+/* Snap within an area, x and y relative to its origin */
+static inline void snap_view(struct view *view, const struct wlr_box *area, int x, int y, int w, int h) {
 	set_view_state(view, VIEW_NORMAL);
-	place_view(view, x, y, w, h);
+	place_view(view, area->x + x, area->y + y, w, h);
+}
+
+/* Maximized and fullscreen views fill the output they are on */
+static void fill_output(struct view *view, const struct output *output) {
+	struct wlr_box area = view->state == VIEW_FULLSCREEN ? output_box(output) : usable_area(output);
+	place_view(view, area.x, area.y, area.width, area.height);
 }
 
-static void toggle_state(const struct server *srv, struct view *view, enum view_state target) {
+static void toggle_state(struct view *view, enum view_state target) {
 	if (view->state == target) {
 		restore_geometry(view);
 	} else {
+		struct output *output = view_output(view);
 		save_geometry(view);
-		int uw, uh;
-		get_usable_area(srv, &uw, &uh);
 		set_view_state(view, target);
-		if (target == VIEW_FULLSCREEN)
-			place_view(view, 0, 0, uw, uh + BAR_HEIGHT);
-		else
-			place_view(view, 0, 0, uw, uh);
+		if (output) fill_output(view, output);
 	}
 }
 
@@ -1016,44 +1959,91 @@ static void begin_grab(struct view *view, uint32_t edges) {
 	view->target_height = 0;
 	if (view->state != VIEW_NORMAL)
 		set_view_state(view, VIEW_NORMAL);
+	damage_view(view);
 	if (edges) {
 		srv->grab_x = srv->cursor->x;
 		srv->grab_y = srv->cursor->y;
 		view->saved_x = view->x;
 		view->saved_y = view->y;
 		get_frame_size(view, &view->saved_width, &view->saved_height);
+		view->resize_serial = 0;
+		view->resize_w = view->resize_h = 0;
+		wlr_xdg_toplevel_set_resizing(view->xdg_toplevel, true);
 	} else {
 		srv->grab_x = srv->cursor->x - view->x;
 		srv->grab_y = srv->cursor->y - view->y;
 	}
 }
 
+/* Send the queued resize unless the last one is still in flight. A client
+   gets a new size only after committing the previous one, so it is never
+   buried in configures it can't keep up with. */
+static void send_resize(struct view *view, bool force) {
+	if (!view->resize_w) return;
+	if (view->resize_serial && !force &&
+			now_ns() - view->resize_sent_ns < (uint64_t)RESIZE_TIMEOUT_MS * 1000000u)
+		return;
+	view->resize_serial = wlr_xdg_toplevel_set_size(view->xdg_toplevel, view->resize_w, view->resize_h);
+	view->resize_sent_ns = now_ns();
+	view->resize_w = view->resize_h = 0;
+}
+
+/* Keep the edges opposite the grabbed ones in place, at the size the client
+   last committed */
+static void anchor_resize(struct view *view) {
+	struct server *srv = view->server;
+	int fw, fh;
+	get_frame_size(view, &fw, &fh);
+	if (srv->resize_edges & WLR_EDGE_LEFT) view->x = view->saved_x + view->saved_width - fw;
+	if (srv->resize_edges & WLR_EDGE_TOP) view->y = view->saved_y + view->saved_height - fh;
+}
+
+static void end_grab(struct server *srv) {
+	struct view *view = srv->grabbed_view;
+	if (!view) return;
+	srv->grabbed_view = NULL;
+	if (!srv->resize_edges) return;
+	send_resize(view, true);
+	wlr_xdg_toplevel_set_resizing(view->xdg_toplevel, false);
+}
+
+/* Topmost view under a layout point. Candidates come from the point's grid
+   bucket and are tried from the top of the stack down. */
 static struct view *view_at(struct server *srv, double lx, double ly,
 		struct wlr_surface **out_surface, double *sx, double *sy) {
-	struct view *view = NULL;
-	wl_list_for_each(view, &srv->views, link) {
-		if (!view_is_visible(view, srv)) continue;
+	double fx = floor(lx), fy = floor(ly);
+	const struct view_bucket *b = &srv->grid[srv->workspace][grid_bucket(grid_cell((int)fx), grid_cell((int)fy))];
+	uint64_t below = UINT64_MAX;
+	for (;;) {
+		struct view *view = NULL;
+		for (int i = 0; i < b->n; i++) {
+			struct view *v = b->views[i];
+			const struct wlr_box *f = &v->index_box;
+			if (v->stack_seq >= below || (view && v->stack_seq < view->stack_seq) ||
+					!view_is_visible(v, srv) ||
+					lx < f->x || lx >= f->x + f->width || ly < f->y || ly >= f->y + f->height)
+				continue;
+			view = v;
+		}
+		if (!view) return NULL;
+		below = view->stack_seq;
+
 		struct wlr_box geo = get_geometry(view);
-		int fw, fh, cx, cy;
-		get_frame_size(view, &fw, &fh);
+		int cx, cy;
 		get_content_pos(view, &cx, &cy);
-
-		if (lx >= view->x && lx < view->x + fw && ly >= view->y && ly < view->y + fh) {
-			if (lx >= cx && lx < cx + geo.width && ly >= cy && ly < cy + geo.height) {
-				double vx = lx - cx + geo.x;
-				double vy = ly - cy + geo.y;
-				struct wlr_surface *found = wlr_xdg_surface_surface_at(view->xdg_toplevel->base, vx, vy, sx, sy);
-				if (found) {
-					*out_surface = found;
-					return view;
-				}
+		if (lx >= cx && lx < cx + geo.width && ly >= cy && ly < cy + geo.height) {
+			double vx = lx - cx + geo.x;
+			double vy = ly - cy + geo.y;
+			struct wlr_surface *found = wlr_xdg_surface_surface_at(view->xdg_toplevel->base, vx, vy, sx, sy);
+			if (found) {
+				*out_surface = found;
+				return view;
 			}
-			if (!get_insets(view).top) continue; /* CSD or fullscreen: no frame to click */
-			*out_surface = NULL;
-			return view;
 		}
+		if (!get_insets(view).top) continue; /* CSD or fullscreen: no frame to click */
+		*out_surface = NULL;
+		return view;
 	}
-	return NULL;
 }
 
 /* ========================================================================== */
@@ -1073,7 +2063,7 @@ static int build_taskbar(struct server *srv, struct tb_btn *btns, int max_x) {
 		.sunken = srv->find_open || (tb_pressed && srv->pressed.tb.type == TB_FIND) };
 	x += TB_WS_W + TB_GAP;
 
-	for (uint8_t ws = 1; ws <= 9; ws++) {
+	for (uint8_t ws = 1; ws <= WORKSPACES; ws++) {
 		btns[n++] = (struct tb_btn){ .x = x, .w = TB_WS_W, .type = TB_WORKSPACE, .workspace = ws,
 			.sunken = srv->workspace == ws ||
 				(tb_pressed && srv->pressed.tb.type == TB_WORKSPACE && srv->pressed.tb.workspace == ws) };
@@ -1082,8 +2072,7 @@ static int build_taskbar(struct server *srv, struct tb_btn *btns, int max_x) {
 
 	struct view *view = NULL;
 	int win_limit = max_x - TB_WIN_W;
-	wl_list_for_each(view, &srv->taskbar_views, taskbar_link) {
-		if (view->workspace != srv->workspace) continue;
+	wl_list_for_each(view, &current_workspace(srv)->taskbar, taskbar_link) {
 		if (n >= TB_BTN_MAX || x > win_limit) break;
 		btns[n++] = (struct tb_btn){ .x = x, .w = TB_WIN_W, .type = TB_WINDOW, .view = view,
 			.sunken = srv->focused_view == view ||
@@ -1094,14 +2083,14 @@ static int build_taskbar(struct server *srv, struct tb_btn *btns, int max_x) {
 	return n;
 }
 
-static struct tb_btn *find_taskbar_hit(const struct server *srv, struct tb_btn *btns, int count,
+static struct tb_btn *find_taskbar_hit(const struct output *output, struct tb_btn *btns, int count,
 		double cx, double cy) {
-	int oh = srv->output->height;
+	int oh = output->wlr_output->height;
 	int ty = oh - BAR_HEIGHT;
 	int bh = TB_BTN_HEIGHT;
 	int y_min = ty + TB_PADDING;
 	int y_max = y_min + bh;
-	int mx = (int)cx, my = (int)cy;
+	int mx = (int)cx - output->lx, my = (int)cy - output->ly;
 	for (int i = 0; i < count; i++) {
 		if (mx >= btns[i].x && mx < btns[i].x + btns[i].w &&
 		    my >= y_min && my < y_max)
@@ -1163,6 +2152,7 @@ static struct find_result find_matching_windows(struct server *srv) {
 static void toggle_find_window(struct server *srv) {
 	srv->find_open = !srv->find_open;
 	if (srv->find_open) { srv->find_query_len = 0; srv->find_selected = 0; }
+	damage_whole(srv);
 }
 
 static void activate_find_selection(struct server *srv) {
@@ -1175,10 +2165,12 @@ static void activate_find_selection(struct server *srv) {
 	srv->workspace = view->workspace;
 	focus_view(view, get_surface(view));
 	srv->find_open = false;
+	damage_whole(srv);
 }
 
 static bool handle_find_key(struct server *srv, xkb_keysym_t sym, bool super_held) {
 	if (super_held) return false;
+	damage_whole(srv);
 
 	if (sym == XKB_KEY_Escape) { srv->find_open = false; return true; }
 	if (sym == XKB_KEY_Return) { activate_find_selection(srv); return true; }
@@ -1223,6 +2215,7 @@ static struct notification *add_notification(struct server *srv,
 	snprintf(notif->body, sizeof(notif->body), "%s", body ? body : "");
 
 	wl_list_insert(&srv->notifications, &notif->link);
+	damage_notifications(srv);
 	return notif;
 }
 
@@ -1232,6 +2225,7 @@ static void close_notification(struct server *srv, uint32_t id) {
 		if (n->id == id) {
 			wl_list_remove(&n->link);
 			free(n);
+			damage_notifications(srv);
 			return;
 		}
 	}
@@ -1267,6 +2261,7 @@ static int handle_notify(sd_bus_message *m, void *userdata, sd_bus_error *err) {
 			if (notif->id == replaces_id) {
 				snprintf(notif->summary, sizeof(notif->summary), "%s", summary ? summary : "");
 				snprintf(notif->body, sizeof(notif->body), "%s", body ? body : "");
+				damage_notifications(srv);
 				return sd_bus_reply_method_return(m, "u", replaces_id);
 			}
 		}
@@ -1393,14 +2388,14 @@ static bool handle_keybinding(struct server *srv, xkb_keysym_t sym, bool super_h
 	if (ws) {
 		if (shift_held) {
 			if (srv->focused_view) {
-				srv->focused_view->workspace = ws;
+				move_view_to_workspace(srv->focused_view, ws);
+				damage_view(srv->focused_view);
+				damage_taskbar(srv);
 				if (ws != srv->workspace)
 					focus_top_view(srv);
 			}
 		} else {
-			srv->workspace = ws;
-			srv->find_open = false;
-			focus_top_view(srv);
+			switch_workspace(srv, ws);
 		}
 		return true;
 	}
@@ -1425,13 +2420,14 @@ static bool handle_keybinding(struct server *srv, xkb_keysym_t sym, bool super_h
 
 	/* Super+F: toggle fullscreen */
 	if (sym == XKB_KEY_f && !shift_held) {
-		if (srv->focused_view) toggle_state(srv, srv->focused_view, VIEW_FULLSCREEN);
+		if (srv->focused_view) toggle_state(srv->focused_view, VIEW_FULLSCREEN);
 		return true;
 	}
 
 	/* Super+G: toggle night mode (blue light filter) */
 	if (sym == XKB_KEY_g && !shift_held) {
 		srv->night_mode = !srv->night_mode;
+		damage_whole(srv);
 		return true;
 	}
 
@@ -1441,9 +2437,19 @@ static bool handle_keybinding(struct server *srv, xkb_keysym_t sym, bool super_h
 		return true;
 	}
 
+	/* Super+P: performance HUD, Super+Shift+P: save the frame profile */
+	if (sym == XKB_KEY_p && !shift_held) {
+		toggle_hud(srv);
+		return true;
+	}
+	if (sym == XKB_KEY_P && shift_held) {
+		write_profile_log(srv);
+		return true;
+	}
+
 	/* Super+M: toggle maximize */
 	if (sym == XKB_KEY_m) {
-		if (srv->focused_view) toggle_state(srv, srv->focused_view, VIEW_MAXIMIZED);
+		if (srv->focused_view) toggle_state(srv->focused_view, VIEW_MAXIMIZED);
 		return true;
 	}
 
@@ -1474,8 +2480,10 @@ static bool handle_keybinding(struct server *srv, xkb_keysym_t sym, bool super_h
 	/* Super+Shift+Arrow: snap to half, or quadrant with chord */
 	if (shift_held && srv->focused_view) {
 		struct view *view = srv->focused_view;
-		int uw, uh;
-		get_usable_area(srv, &uw, &uh);
+		struct output *output = view_output(view);
+		if (!output) return true;
+		struct wlr_box area = usable_area(output);
+		int uw = area.width, uh = area.height;
 		int hw = uw / 2, hh = uh / 2;
 
 		/* Check if this completes a chord for quadrant snap */
@@ -1488,7 +2496,7 @@ static bool handle_keybinding(struct server *srv, xkb_keysym_t sym, bool super_h
 				srv->snap_chord = 0;
 				int x = (first == XKB_KEY_Right) ? hw : 0;
 				int y = (sym == XKB_KEY_Up) ? 0 : hh;
-				snap_view(view, x, y, hw, hh);
+				snap_view(view, &area, x, y, hw, hh);
 				return true;
 			}
 			/* first = Up/Down, second = Left/Right → quadrant */
@@ -1497,17 +2505,17 @@ static bool handle_keybinding(struct server *srv, xkb_keysym_t sym, bool super_h
 				srv->snap_chord = 0;
 				int x = (sym == XKB_KEY_Right) ? hw : 0;
 				int y = (first == XKB_KEY_Up) ? 0 : hh;
-				snap_view(view, x, y, hw, hh);
+				snap_view(view, &area, x, y, hw, hh);
 				return true;
 			}
 			/* Same axis or other key - start fresh chord below */
 		}
 
 		/* Snap to half and start chord for potential quadrant */
-		if (sym == XKB_KEY_Left)  { srv->snap_chord = sym; snap_view(view, 0,  0, hw, uh); return true; }
-		if (sym == XKB_KEY_Right) { srv->snap_chord = sym; snap_view(view, hw, 0, hw, uh); return true; }
-		if (sym == XKB_KEY_Up)    { srv->snap_chord = sym; snap_view(view, 0,  0, uw, hh); return true; }
-		if (sym == XKB_KEY_Down)  { srv->snap_chord = sym; snap_view(view, 0, hh, uw, hh); return true; }
+		if (sym == XKB_KEY_Left)  { srv->snap_chord = sym; snap_view(view, &area, 0,  0, hw, uh); return true; }
+		if (sym == XKB_KEY_Right) { srv->snap_chord = sym; snap_view(view, &area, hw, 0, hw, uh); return true; }
+		if (sym == XKB_KEY_Up)    { srv->snap_chord = sym; snap_view(view, &area, 0,  0, uw, hh); return true; }
+		if (sym == XKB_KEY_Down)  { srv->snap_chord = sym; snap_view(view, &area, 0, hh, uw, hh); return true; }
 	}
 
 	return false;
@@ -1540,8 +2548,8 @@ static void keyboard_handle_key(struct wl_listener *listener, void *data) {
 	if (event->state == WL_KEYBOARD_KEY_STATE_PRESSED) {
 		/* Brightness control: XF86 keys */
 		for (int i = 0; i < nsyms; i++) {
-			if (syms[i] == XKB_KEY_XF86MonBrightnessDown) { sysinfo_adjust_brightness(-1); handled = true; break; }
-			if (syms[i] == XKB_KEY_XF86MonBrightnessUp) { sysinfo_adjust_brightness(1); handled = true; break; }
+			if (syms[i] == XKB_KEY_XF86MonBrightnessDown) { adjust_brightness(srv, -1); handled = true; break; }
+			if (syms[i] == XKB_KEY_XF86MonBrightnessUp) { adjust_brightness(srv, 1); handled = true; break; }
 		}
 		if (!handled && srv->find_open) {
 			for (int i = 0; i < nsyms; i++)
@@ -1600,6 +2608,9 @@ static void server_new_keyboard(struct server *srv, struct wlr_input_device *dev
 /* ========================================================================== */
 
 static void process_cursor_motion(struct server *srv, uint32_t time) {
+	/* The cursor (and its trail) is drawn by us, so every motion needs a frame */
+	schedule_frames(srv);
+
 	if (srv->grabbed_view) {
 		if (srv->resize_edges) {
 			struct view *view = srv->grabbed_view;
@@ -1613,15 +2624,16 @@ static void process_cursor_motion(struct server *srv, uint32_t time) {
 			int new_h = view->saved_height + sh * dy;
 			if (new_w < 100) new_w = 100;
 			if (new_h < 60) new_h = 60;
-			view->x = view->saved_x + lx * dx;
-			view->y = view->saved_y + ty * dy;
 			struct frame_insets fi = get_insets(view);
-			wlr_xdg_toplevel_set_size(view->xdg_toplevel,
-				new_w - fi.left - fi.right, new_h - fi.top - fi.bottom);
+			view->resize_w = new_w - fi.left - fi.right;
+			view->resize_h = new_h - fi.top - fi.bottom;
+			send_resize(view, false);
+			anchor_resize(view);
 		} else {
 			srv->grabbed_view->x = (int)(srv->cursor->x - srv->grab_x);
 			srv->grabbed_view->y = (int)(srv->cursor->y - srv->grab_y);
 		}
+		damage_view(srv->grabbed_view);
 		return;
 	}
 
@@ -1635,6 +2647,31 @@ static void process_cursor_motion(struct server *srv, uint32_t time) {
 	} else {
 		wlr_seat_pointer_clear_focus(srv->seat);
 	}
+	srv->pointer_frame_pending = true;
+}
+
+/* End the batch of pointer events sent since the last frame, if any */
+static void send_pointer_frame(struct server *srv) {
+	if (!srv->pointer_frame_pending) return;
+	srv->pointer_frame_pending = false;
+	wlr_seat_pointer_notify_frame(srv->seat);
+}
+
+/* Motion only moves the cursor right away. Hit testing, seat focus and grab
+   updates run once per output frame for everything that arrived since, or
+   before a button or axis event so those go to the right surface. */
+static void queue_cursor_motion(struct server *srv, uint32_t time) {
+	srv->motion_time = time;
+	if (srv->motion_pending) return;
+	srv->motion_pending = true;
+	schedule_frames(srv);
+}
+
+static void flush_cursor_motion(struct server *srv) {
+	if (!srv->motion_pending) return;
+	srv->motion_pending = false;
+	process_cursor_motion(srv, srv->motion_time);
+	send_pointer_frame(srv);
 }
 
 static void server_cursor_motion(struct wl_listener *listener, void *data) {
@@ -1648,20 +2685,22 @@ static void server_cursor_motion(struct wl_listener *listener, void *data) {
 		/* Pointer is locked - don't move cursor, just send relative motion */
 	} else {
 		wlr_cursor_move(srv->cursor, &event->pointer->base, dx, dy);
-		process_cursor_motion(srv, event->time_msec);
+		queue_cursor_motion(srv, event->time_msec);
 	}
 
+	/* Relative motion is not coalesced, clients holding a constraint get every event */
 	wlr_relative_pointer_manager_v1_send_relative_motion(
 		srv->relative_pointer_manager, srv->seat,
 		(uint64_t)event->time_msec * 1000,
 		dx, dy, dx, dy);
+	srv->pointer_frame_pending = true;
 }
 
 static void server_cursor_motion_absolute(struct wl_listener *listener, void *data) {
 	struct server *srv = wl_container_of(listener, srv, cursor_motion_absolute);
 	struct wlr_pointer_motion_absolute_event *event = data;
 	wlr_cursor_warp_absolute(srv->cursor, &event->pointer->base, event->x, event->y);
-	process_cursor_motion(srv, event->time_msec);
+	queue_cursor_motion(srv, event->time_msec);
 }
 
 static void handle_title_button_release(struct server *srv) {
@@ -1671,7 +2710,7 @@ static void handle_title_button_release(struct server *srv) {
 	if (btn != srv->pressed.title.button) return;
 	switch (btn) {
 	case ICON_CLOSE:    wlr_xdg_toplevel_send_close(v->xdg_toplevel); break;
-	case ICON_MAXIMIZE: toggle_state(srv, v, VIEW_MAXIMIZED); break;
+	case ICON_MAXIMIZE: toggle_state(v, VIEW_MAXIMIZED); break;
 	case ICON_MINIMIZE: set_view_state(v, VIEW_MINIMIZED); defocus_view(srv, v); break;
 	default: break;
 	}
@@ -1688,11 +2727,8 @@ static void handle_taskbar_release(struct server *srv, const struct tb_btn *hit)
 		toggle_find_window(srv);
 		break;
 	case TB_WORKSPACE:
-		if (hit->workspace == srv->pressed.tb.workspace) {
-			srv->workspace = hit->workspace;
-			srv->find_open = false;
-			focus_top_view(srv);
-		}
+		if (hit->workspace == srv->pressed.tb.workspace)
+			switch_workspace(srv, hit->workspace);
 		break;
 	case TB_WINDOW:
 		if (hit->view == srv->pressed.tb.view) {
@@ -1708,12 +2744,14 @@ static void handle_taskbar_release(struct server *srv, const struct tb_btn *hit)
 	}
 }
 
-static void handle_button_press(struct server *srv, struct tb_btn *tb_btns, int tb_count, uint32_t time, uint32_t button) {
+static void handle_button_press(struct server *srv, const struct output *output,
+		struct tb_btn *tb_btns, int tb_count, uint32_t time, uint32_t button) {
 	/* Check for notification click first */
 	struct notification *notif = notification_at(srv, srv->cursor->x, srv->cursor->y);
 	if (notif) {
 		wl_list_remove(&notif->link);
 		free(notif);
+		damage_notifications(srv);
 		return;
 	}
 
@@ -1725,56 +2763,74 @@ static void handle_button_press(struct server *srv, struct tb_btn *tb_btns, int
 		if (surface) {
 			focus_view(view, surface);
 			wlr_seat_pointer_notify_button(srv->seat, time, button, WL_POINTER_BUTTON_STATE_PRESSED);
+			srv->pointer_frame_pending = true;
 		} else {
 			focus_view(view, get_surface(view));
 			wlr_seat_pointer_clear_focus(srv->seat);
 			enum box_icon btn = hit_test_title_bar_button(view, get_geometry(view).width,
 				srv->cursor->x, srv->cursor->y);
-			if (btn != ICON_NONE)
+			if (btn != ICON_NONE) {
 				srv->pressed = (struct pressed_state){ .type = PRESSED_TITLE_BUTTON, .title = { view, btn } };
-			else
+				damage_view(view);
+			} else {
 				begin_grab(view, 0);
+			}
 		}
 	} else {
-		const struct tb_btn *hit = find_taskbar_hit(srv, tb_btns, tb_count, srv->cursor->x, srv->cursor->y);
-		if (hit)
+		const struct tb_btn *hit = output ?
+			find_taskbar_hit(output, tb_btns, tb_count, srv->cursor->x, srv->cursor->y) : NULL;
+		if (hit) {
 			srv->pressed = (struct pressed_state){ .type = PRESSED_TASKBAR, .tb = *hit };
-		else
+			damage_taskbar(srv);
+		} else {
 			wlr_seat_pointer_notify_button(srv->seat, time, button, WL_POINTER_BUTTON_STATE_PRESSED);
+			srv->pointer_frame_pending = true;
+		}
 	}
 }
 
 static void server_cursor_button(struct wl_listener *listener, void *data) {
 	struct server *srv = wl_container_of(listener, srv, cursor_button);
 	struct wlr_pointer_button_event *event = data;
+	flush_cursor_motion(srv);
 
+	/* Taskbar of the output under the cursor */
+	struct output *output = output_at(srv, srv->cursor->x, srv->cursor->y);
 	struct tb_btn tb_btns[TB_BTN_MAX];
-	int tb_count = build_taskbar(srv, tb_btns, srv->output->width);
+	int tb_count = output ? build_taskbar(srv, tb_btns, output->wlr_output->width) : 0;
 
 	if (event->state == WL_POINTER_BUTTON_STATE_RELEASED) {
-		if (srv->pressed.type == PRESSED_TITLE_BUTTON)
+		if (srv->pressed.type == PRESSED_TITLE_BUTTON) {
+			damage_view(srv->pressed.title.view);
 			handle_title_button_release(srv);
-		else if (srv->pressed.type == PRESSED_TASKBAR)
-			handle_taskbar_release(srv, find_taskbar_hit(srv, tb_btns, tb_count, srv->cursor->x, srv->cursor->y));
+		} else if (srv->pressed.type == PRESSED_TASKBAR) {
+			damage_taskbar(srv);
+			handle_taskbar_release(srv, output ?
+				find_taskbar_hit(output, tb_btns, tb_count, srv->cursor->x, srv->cursor->y) : NULL);
+		}
 		srv->pressed.type = PRESSED_NONE;
-		srv->grabbed_view = NULL;
+		end_grab(srv);
 		wlr_seat_pointer_notify_button(srv->seat, event->time_msec, event->button, event->state);
+		srv->pointer_frame_pending = true;
 	} else {
-		handle_button_press(srv, tb_btns, tb_count, event->time_msec, event->button);
+		handle_button_press(srv, output, tb_btns, tb_count, event->time_msec, event->button);
 	}
 }
 
 static void server_cursor_axis(struct wl_listener *listener, void *data) {
 	struct server *srv = wl_container_of(listener, srv, cursor_axis);
 	struct wlr_pointer_axis_event *event = data;
+	flush_cursor_motion(srv);
 	wlr_seat_pointer_notify_axis(srv->seat, event->time_msec, event->orientation,
 		-event->delta, -event->delta_discrete, event->source, event->relative_direction);
+	srv->pointer_frame_pending = true;
 }
 
 static void server_cursor_frame(struct wl_listener *listener, void *data) {
 	struct server *srv = wl_container_of(listener, srv, cursor_frame);
 	(void)data;
-	wlr_seat_pointer_notify_frame(srv->seat);
+	/* Queued absolute motion leaves nothing to end; flush_cursor_motion sends its own */
+	send_pointer_frame(srv);
 }
 
 static void handle_constraint_destroy(struct wl_listener *listener, void *data) {
@@ -1859,31 +2915,36 @@ static void render_surface(struct server *srv, struct view *view,
 	struct wlr_gles2_texture_attribs attribs;
 	wlr_gles2_texture_get_attribs(texture, &attribs);
 
-	bool external = attribs.target == GL_TEXTURE_EXTERNAL_OES;
-	GLuint program = external ? srv->ext_prog : srv->ui_prog;
-	GLint res_loc = external ? srv->ext_res_loc : srv->res_loc;
+	struct wlr_box geo = get_geometry(view);
+	int cx, cy;
+	get_content_pos(view, &cx, &cy);
+	int dx = cx + sx - geo.x;
+	int dy = cy + sy - geo.y;
+
+	/* 2D textures join the UI batch on their own texture unit */
+	if (attribs.target == GL_TEXTURE_2D) {
+		uint8_t slot = bind_texture_slot(srv, attribs.tex);
+		struct box_instance *inst = queue_box(srv, dx, dy, surface->current.width,
+			surface->current.height, STYLE_TEXTURED, NULL, ICON_NONE);
+		if (inst) inst->params[2] = slot;
+		return;
+	}
 
-	glUseProgram(program);
-	glUniform2f(res_loc, (float)srv->output->width, (float)srv->output->height);
+	/* External (OES) textures need their own program, so they break the batch */
+	flush_boxes(srv);
+	glUseProgram(srv->ext_prog);
 
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(attribs.target, attribs.tex);
 	glTexParameteri(attribs.target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(attribs.target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-	struct wlr_box geo = get_geometry(view);
-	int cx, cy;
-	get_content_pos(view, &cx, &cy);
-	int dx = cx + sx - geo.x;
-	int dy = cy + sy - geo.y;
-
 	queue_box(srv, dx, dy, surface->current.width, surface->current.height,
 		STYLE_TEXTURED, NULL, ICON_NONE);
 	flush_boxes(srv);
 
 	/* Restore UI state for subsequent draws */
 	glUseProgram(srv->ui_prog);
-	glUniform2f(srv->res_loc, (float)srv->output->width, (float)srv->output->height);
 	if (srv->glyph_atlas)
 		glBindTexture(GL_TEXTURE_2D, srv->glyph_atlas);
 }
@@ -1928,8 +2989,31 @@ static void render_window_frame(struct server *srv,
 	}
 }
 
-static void render_taskbar(struct server *srv) {
-	int ow = srv->output->width, oh = srv->output->height;
+/* Window frame from its instance cache, rebuilt when anything it shows changed */
+static void render_view_frame(struct server *srv, struct view *view) {
+	bool active = srv->focused_view == view;
+	enum box_icon pressed = srv->pressed.type == PRESSED_TITLE_BUTTON &&
+		srv->pressed.title.view == view ? srv->pressed.title.button : ICON_NONE;
+	struct box_cache *cache = &view->frame_cache;
+	if (cache->valid && view->frame_key.cw == view->content_w && view->frame_key.ch == view->content_h &&
+			view->frame_key.active == active && view->frame_key.pressed == pressed &&
+			view->frame_key.title_gen == view->title_gen) {
+		cache_replay(srv, cache, view->x, view->y);
+		return;
+	}
+	size_t start = srv->batch_n;
+	render_window_frame(srv, view, view->content_w, view->content_h, active);
+	cache_record(srv, cache, start, view->x, view->y);
+	view->frame_key.cw = view->content_w;
+	view->frame_key.ch = view->content_h;
+	view->frame_key.active = active;
+	view->frame_key.pressed = pressed;
+	view->frame_key.title_gen = view->title_gen;
+}
+
+/* Taskbar boxes in output coordinates */
+static void queue_taskbar(struct server *srv, const struct wlr_output *wlr_output) {
+	int ow = wlr_output->width, oh = wlr_output->height;
 	int ty = oh - BAR_HEIGHT;
 	int bh = TB_BTN_HEIGHT;
 	int text_h = FONT_SIZE + 4;
@@ -1960,18 +3044,102 @@ static void render_taskbar(struct server *srv) {
 		}
 	}
 
-	/* Status area on the right side (background thread updates values) */
-	sysinfo_get(&srv->cached_sysinfo);
-	const char *status = sysinfo_format_status(&srv->cached_sysinfo);
+	/* Status area on the right side (rebuilt by update_status) */
+	const char *status = srv->status;
 	if (status[0]) {
-		int status_w = measure_text(srv, status, 400);
+		if (srv->status_w < 0) srv->status_w = measure_text(srv, status, 400);
+		int status_w = srv->status_w;
 		int status_pad = 8;
 		int status_x = ow - status_w - status_pad;
 		draw_sunken(srv, status_x - 4, ty + TB_PADDING, status_w + 8, bh, COLOR_BUTTON, ICON_NONE);
 		draw_text(srv, status, 400, status_x, ty + TB_PADDING + (bh - text_h) / 2);
+
+		/* One bar per cpu sample, newest on the right */
+		const struct sysinfo *info = &srv->cached_sysinfo;
+		if (srv->cpu_graph && info->cpu_history_len > 0) {
+			int graph_w = SYSINFO_HISTORY * TB_GRAPH_BAR + 4;
+			int graph_x = status_x - 4 - TB_GAP - graph_w;
+			int inner_h = bh - 4, base_y = ty + TB_PADDING + 2 + inner_h;
+			draw_sunken(srv, graph_x, ty + TB_PADDING, graph_w, bh, COLOR_BUTTON, ICON_NONE);
+			for (int i = 0; i < info->cpu_history_len; i++) {
+				int h = info->cpu_history[i] * inner_h / 100;
+				if (h < 1) h = 1;
+				int x = graph_x + 2 + (SYSINFO_HISTORY - info->cpu_history_len + i) * TB_GRAPH_BAR;
+				draw_raised(srv, x, base_y - h, TB_GRAPH_BAR, h, COLOR_FRAME_ACTIVE, ICON_NONE);
+			}
+		}
 	}
 }
 
+static void render_taskbar(struct server *srv, struct output *output) {
+	int ow = output->wlr_output->width, oh = output->wlr_output->height;
+	struct box_cache *cache = &output->taskbar_cache;
+	if (cache->valid && !output->taskbar_dirty && output->taskbar_w == ow && output->taskbar_h == oh) {
+		cache_replay(srv, cache, output->lx, output->ly);
+		return;
+	}
+	size_t start = srv->batch_n;
+	queue_taskbar(srv, output->wlr_output);
+	shift_boxes(srv, start, output->lx, output->ly);
+	if (cache_record(srv, cache, start, output->lx, output->ly)) {
+		output->taskbar_w = ow;
+		output->taskbar_h = oh;
+		output->taskbar_dirty = false;
+	}
+}
+
+/* The status text is only formatted when its inputs change: the sysinfo
+   thread publishing new values, or the clock turning a minute. The taskbar
+   box cache keeps its glyphs in between, so frames never touch it. */
+static void update_status(struct server *srv) {
+	const char *status = sysinfo_format_status(&srv->cached_sysinfo);
+	if (strcmp(status, srv->status) != 0) {
+		snprintf(srv->status, sizeof(srv->status), "%s", status);
+		srv->status_w = -1;
+		damage_taskbar(srv);
+	}
+}
+
+static int status_notify_handler(int fd, uint32_t mask, void *data) {
+	struct server *srv = data;
+	(void)fd; (void)mask;
+	sysinfo_ack_notify();
+	unsigned gen = sysinfo_generation();
+	if (gen == srv->status_gen) return 0;
+	srv->status_gen = gen;
+	unsigned char history[SYSINFO_HISTORY];
+	memcpy(history, srv->cached_sysinfo.cpu_history, sizeof(history));
+	sysinfo_get(&srv->cached_sysinfo);
+	if (srv->cpu_graph && memcmp(history, srv->cached_sysinfo.cpu_history, sizeof(history)) != 0)
+		damage_taskbar(srv);
+	update_status(srv);
+	return 0;
+}
+
+/* Re-arm for just after the next minute starts. Local time is offset from
+   UTC by whole minutes, so a UTC minute boundary is a local one too. */
+static void schedule_clock(struct server *srv) {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	long ms = 60000 - (long)(ts.tv_sec % 60) * 1000 - ts.tv_nsec / 1000000;
+	wl_event_source_timer_update(srv->clock_timer, (int)ms + 5);
+}
+
+static int clock_timer_handler(void *data) {
+	struct server *srv = data;
+	update_status(srv);
+	schedule_clock(srv);
+	return 0;
+}
+
+/* The sysinfo thread writes the backlight; the taskbar shows the new value now */
+static void adjust_brightness(struct server *srv, int delta) {
+	int percent = sysinfo_adjust_brightness(delta);
+	if (percent < 0) return;
+	srv->cached_sysinfo.brightness_percent = percent;
+	update_status(srv);
+}
+
 struct dialog_layout {
 	int x, y, w, h;
 	int content_x, content_w;
@@ -2001,8 +3169,9 @@ static struct dialog_layout calc_dialog_layout(int screen_w, int screen_h, size_
 	};
 }
 
-static void render_find_overlay(struct server *srv) {
+static void render_find_overlay(struct server *srv, const struct output *output) {
 	if (!srv->find_open) return;
+	size_t start = srv->batch_n;
 
 	struct find_result matches = find_matching_windows(srv);
 	size_t visible = matches.count < 8 ? matches.count : 8;
@@ -2013,7 +3182,7 @@ static void render_find_overlay(struct server *srv) {
 		srv->find_selected = 0;
 
 	struct dialog_layout l = calc_dialog_layout(
-		srv->output->width, srv->output->height, visible);
+		output->wlr_output->width, output->wlr_output->height, visible);
 
 	draw_raised(srv, l.x, l.y, l.w, l.h, COLOR_BUTTON, ICON_NONE);
 	draw_sunken(srv, l.content_x, l.input_y, l.content_w, l.input_h, COLOR_BUTTON, ICON_NONE);
@@ -2036,12 +3205,14 @@ static void render_find_overlay(struct server *srv) {
 
 	if (matches.count == 0 && srv->find_query_len > 0)
 		draw_text(srv, "No windows found", l.content_w - 8, l.content_x + 4, l.list_y + l.text_inset);
+	shift_boxes(srv, start, output->lx, output->ly);
 }
 
-static void render_notifications(struct server *srv) {
+static void render_notifications(struct server *srv, const struct output *output) {
 	if (wl_list_empty(&srv->notifications)) return;
 
-	int x = srv->output->width - NOTIF_WIDTH - NOTIF_PADDING;
+	size_t start = srv->batch_n;
+	int x = output->wlr_output->width - NOTIF_WIDTH - NOTIF_PADDING;
 	int y = NOTIF_PADDING;
 	int text_y_off = (NOTIF_HEIGHT / 2 - FONT_SIZE - 4) / 2;
 
@@ -2056,15 +3227,19 @@ static void render_notifications(struct server *srv) {
 		draw_text(srv, n->body, NOTIF_WIDTH - 16, x + 8, y + NOTIF_HEIGHT / 2 + text_y_off);
 
 		y += NOTIF_HEIGHT + NOTIF_GAP;
-		if ((unsigned)y + NOTIF_HEIGHT > (unsigned)srv->output->height) break;
+		if ((unsigned)y + NOTIF_HEIGHT > (unsigned)output->wlr_output->height) break;
 	}
+	shift_boxes(srv, start, output->lx, output->ly);
 }
 
 static struct notification *notification_at(struct server *srv, double cx, double cy) {
-	if (wl_list_empty(&srv->notifications)) return NULL;
+	const struct output *output = primary_output(srv);
+	if (!output || wl_list_empty(&srv->notifications)) return NULL;
 
-	int x = srv->output->width - NOTIF_WIDTH - NOTIF_PADDING;
+	int x = output->wlr_output->width - NOTIF_WIDTH - NOTIF_PADDING;
 	int y = NOTIF_PADDING;
+	cx -= output->lx;
+	cy -= output->ly;
 
 	struct notification *n = NULL;
 	wl_list_for_each(n, &srv->notifications, link) {
@@ -2073,45 +3248,511 @@ static struct notification *notification_at(struct server *srv, double cx, doubl
 			return n;
 		}
 		y += NOTIF_HEIGHT + NOTIF_GAP;
-		if ((unsigned)y + NOTIF_HEIGHT > (unsigned)srv->output->height) break;
+		if ((unsigned)y + NOTIF_HEIGHT > (unsigned)output->wlr_output->height) break;
 	}
 	return NULL;
 }
 
 
 /* ========================================================================== */
-/* Output                                                                      */
+/* Frame profiling                                                             */
 /* ========================================================================== */
 
-static void update_geometry(struct view *view) {
-	struct wlr_box geo = get_geometry(view);
-	struct frame_insets fi = get_insets(view);
-	int cw = view->target_width > geo.width ? view->target_width : geo.width;
-	int ch = view->target_height > geo.height ? view->target_height : geo.height;
-	view->content_w = cw;
-	view->content_h = ch;
-	view->frame_w = cw + fi.left + fi.right;
-	view->frame_h = ch + fi.top + fi.bottom;
+static const char *const phase_names[PHASE_COUNT] = {
+	"background", "views", "taskbar", "overlays", "flush", "night", "commit",
+};
+
+static struct frame_profile *profile_entry(struct server *srv, uint64_t seq) {
+	struct frame_profile *prof = &srv->profile[seq % PROF_HISTORY];
+	return seq && prof->seq == seq ? prof : NULL;
+}
+
+static struct frame_profile *begin_profile(struct server *srv, const struct output *output,
+		uint64_t start_ns) {
+	uint64_t seq = ++srv->profile_seq;
+	struct frame_profile *prof = &srv->profile[seq % PROF_HISTORY];
+	memset(prof, 0, sizeof(*prof));
+	prof->seq = seq;
+	prof->start_ns = start_ns;
+	prof->gpu_us = -1;
+	prof->present_us = -1;
+	snprintf(prof->output, sizeof(prof->output), "%s", output->wlr_output->name);
+	return prof;
+}
+
+/* Charge the time since *t to a phase and restart the clock */
+static void profile_phase(struct frame_profile *prof, enum prof_phase phase, uint64_t *t) {
+	uint64_t now = now_ns();
+	prof->cpu_us[phase] += (uint32_t)((now - *t) / 1000);
+	*t = now;
+}
+
+/* Collect the GPU time of the output's previous frame and time the next one.
+   The result is normally ready by then; one still pending is dropped. */
+static void begin_gpu_query(struct server *srv, struct output *output, uint64_t frame) {
+	if (!srv->gpu_timer_checked) {
+		const char *exts = (const char *)glGetString(GL_EXTENSIONS);
+		srv->gpu_timer = exts && strstr(exts, "GL_EXT_disjoint_timer_query");
+		srv->gpu_timer_checked = true;
+	}
+	if (!srv->gpu_timer) return;
+	if (!output->gpu_query) glGenQueries(1, &output->gpu_query);
+
+	struct frame_profile *prof = profile_entry(srv, output->gpu_query_frame);
+	if (prof) {
+		GLuint available = 0, ns = 0;
+		GLint disjoint = 0;
+		glGetQueryObjectuiv(output->gpu_query, GL_QUERY_RESULT_AVAILABLE, &available);
+		glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+		if (available && !disjoint) {
+			glGetQueryObjectuiv(output->gpu_query, GL_QUERY_RESULT, &ns);
+			prof->gpu_us = (int32_t)(ns / 1000);
+			output->gpu_last_us = ns / 1000;
+			srv->bench.gpu_us += ns / 1000;
+			srv->bench.gpu_frames++;
+		}
+	}
+	glBeginQuery(GL_TIME_ELAPSED_EXT, output->gpu_query);
+	output->gpu_query_frame = frame;
+}
+
+static void end_gpu_query(const struct server *srv) {
+	if (srv->gpu_timer) glEndQuery(GL_TIME_ELAPSED_EXT);
+}
+
+static void presentation_textured_iterator(struct wlr_surface *surface, int sx, int sy, void *data) {
+	(void)sx; (void)sy;
+	wlr_presentation_surface_textured_on_output(surface, data);
+}
+
+/* Queue presentation feedback for a view shown by an output commit and start
+   timing its oldest unpresented content */
+static void present_view(struct view *view, struct wlr_output *wlr_output, uint64_t commit, bool scanout) {
+	if (scanout)
+		wlr_presentation_surface_scanned_out_on_output(get_surface(view), wlr_output);
+	else
+		wlr_xdg_surface_for_each_surface(view->xdg_toplevel->base,
+			presentation_textured_iterator, wlr_output);
+
+	struct view_latency *lat = &view->latency;
+	if (lat->pending_ns) {
+		lat->inflight_ns = lat->pending_ns;
+		lat->pending_ns = 0;
+	}
+	if (lat->inflight_ns) lat->inflight_commit = commit;
+}
+
+/* An output commit was presented at when (0 = discarded) */
+static void record_view_latency(struct server *srv, uint64_t commit, uint64_t when) {
+	struct view *view = NULL;
+	wl_list_for_each(view, &srv->views, link) {
+		struct view_latency *lat = &view->latency;
+		if (!lat->inflight_ns || lat->inflight_commit != commit) continue;
+		if (when) {
+			uint32_t us = (uint32_t)((when > lat->inflight_ns ? when - lat->inflight_ns : 0) / 1000);
+			lat->samples[lat->count % LATENCY_SAMPLES] = us;
+			lat->count++;
+			if (us > lat->max_us) lat->max_us = us;
+		}
+		lat->inflight_ns = 0;
+	}
+}
+
+static int compare_u32(const void *a, const void *b) {
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+	return (x > y) - (x < y);
+}
+
+/* Log each view's commit-to-present latency: percentiles over its last
+   LATENCY_SAMPLES presented commits, maximum since it was mapped */
+static void log_view_latency(struct server *srv) {
+	struct view *view = NULL;
+	wl_list_for_each(view, &srv->views, link) {
+		const struct view_latency *lat = &view->latency;
+		if (!lat->count) continue;
+		uint32_t sorted[LATENCY_SAMPLES];
+		size_t n = lat->count < LATENCY_SAMPLES ? (size_t)lat->count : LATENCY_SAMPLES;
+		memcpy(sorted, lat->samples, n * sizeof(sorted[0]));
+		qsort(sorted, n, sizeof(sorted[0]), compare_u32);
+		wlr_log(WLR_INFO, "latency '%s' (pid %d): %" PRIu64 " presented, "
+			"p50 %.2f ms, p99 %.2f ms, max %.2f ms", view->title, (int)view->pid, lat->count,
+			sorted[n / 2] / 1000.0, sorted[(n - 1) * 99 / 100] / 1000.0, lat->max_us / 1000.0);
+	}
+}
+
+/* The HUD sits in the top-left corner of the primary output */
+static struct wlr_box hud_box(const struct output *output) {
+	return (struct wlr_box){ output->lx + NOTIF_PADDING, output->ly + NOTIF_PADDING,
+		HUD_WIDTH, HUD_LINES * HUD_LINE_H + 12 };
+}
+
+static void damage_hud(struct server *srv) {
+	const struct output *output = primary_output(srv);
+	if (!output) return;
+	struct wlr_box box = hud_box(output);
+	damage_box(srv, &box);
+}
+
+static void render_hud(struct server *srv, const struct output *output) {
+	if (!srv->hud_open) return;
+	struct wlr_box box = hud_box(output);
+	draw_raised(srv, box.x, box.y, box.width, box.height, COLOR_BUTTON, ICON_NONE);
+	for (int i = 0; i < HUD_LINES; i++)
+		draw_text(srv, srv->hud_text[i], box.width - 16, box.x + 8, box.y + 6 + i * HUD_LINE_H);
+}
+
+/* Milliseconds with two decimals, clamped so the HUD lines provably fit */
+static void format_ms(char buf[8], double us) {
+	double hundredths = us / 10.0 + 0.5;
+	unsigned v = hundredths < 0.0 ? 0 : hundredths > 999999.0 ? 999999 : (unsigned)hundredths;
+	snprintf(buf, 8, "%u.%02u", v / 100 % 10000, v % 100);
+}
+
+/* Summarize the last HUD_WINDOW frames; repaint the HUD only if the text changed */
+static void update_hud(struct server *srv) {
+	double cpu = 0.0, cpu_max = 0.0, gpu = 0.0, present = 0.0, phase[PHASE_COUNT] = { 0.0 };
+	int n = 0, gpu_n = 0, present_n = 0, missed = 0;
+	const struct frame_profile *last = NULL;
+	for (uint64_t seq = srv->profile_seq; seq > 0 && n < HUD_WINDOW; seq--) {
+		const struct frame_profile *prof = profile_entry(srv, seq);
+		if (!prof) break;
+		if (!last) last = prof;
+		n++;
+		cpu += prof->cpu_total_us;
+		if (prof->cpu_total_us > cpu_max) cpu_max = prof->cpu_total_us;
+		for (int i = 0; i < PHASE_COUNT; i++) phase[i] += prof->cpu_us[i];
+		if (prof->gpu_us >= 0) { gpu += prof->gpu_us; gpu_n++; }
+		if (prof->present_us >= 0) { present += prof->present_us; present_n++; }
+		if (prof->missed) missed++;
+	}
+
+	char text[HUD_LINES][sizeof(srv->hud_text[0])];
+	memset(text, 0, sizeof(text));
+	if (!last) {
+		snprintf(text[0], sizeof(text[0]), "No frames yet");
+	} else {
+		double k = 1.0 / n;
+		char ms[PHASE_COUNT][8], cpu_ms[8], max_ms[8], gpu_ms[8], present_ms[8];
+		for (int i = 0; i < PHASE_COUNT; i++) format_ms(ms[i], phase[i] * k);
+		format_ms(cpu_ms, cpu * k);
+		format_ms(max_ms, cpu_max);
+		char gpu_text[12] = "gpu n/a";
+		if (gpu_n) {
+			format_ms(gpu_ms, gpu / gpu_n);
+			snprintf(gpu_text, sizeof(gpu_text), "gpu %s", gpu_ms);
+		}
+		snprintf(text[0], sizeof(text[0]), "cpu %s max %s %s ms", cpu_ms, max_ms, gpu_text);
+		snprintf(text[1], sizeof(text[1]), "bg %s views %s bar %s ovl %s",
+			ms[PHASE_BACKGROUND], ms[PHASE_VIEWS], ms[PHASE_TASKBAR], ms[PHASE_OVERLAYS]);
+		snprintf(text[2], sizeof(text[2]), "flush %s night %s commit %s",
+			ms[PHASE_FLUSH], ms[PHASE_NIGHT], ms[PHASE_COMMIT]);
+		snprintf(text[3], sizeof(text[3]), "%u draws %u boxes %u uploads",
+			last->draw_calls, last->instances, last->uploads);
+		if (present_n) {
+			format_ms(present_ms, present / present_n);
+			snprintf(text[4], sizeof(text[4]), "present %s ms, missed %d/%d",
+				present_ms, missed, n);
+		}
+		else
+			snprintf(text[4], sizeof(text[4]), "present n/a, missed %d/%d", missed, n);
+	}
+	if (memcmp(text, srv->hud_text, sizeof(text)) != 0) {
+		memcpy(srv->hud_text, text, sizeof(text));
+		damage_hud(srv);
+	}
+}
+
+static int hud_timer_handler(void *data) {
+	struct server *srv = data;
+	if (!srv->hud_open) return 0;
+	update_hud(srv);
+	wl_event_source_timer_update(srv->hud_timer, HUD_INTERVAL_MS);
+	return 0;
+}
+
+static void toggle_hud(struct server *srv) {
+	srv->hud_open = !srv->hud_open;
+	damage_hud(srv);
+	if (srv->hud_open && srv->hud_timer)
+		wl_event_source_timer_update(srv->hud_timer, 1);
+}
+
+/* Write the profile log as CSV, oldest frame first, and log view latencies */
+static void write_profile_log(struct server *srv) {
+	log_view_latency(srv);
+
+	char path[256];
+	const char *env = getenv("RWM_PROFILE_LOG");
+	const char *dir = getenv("XDG_RUNTIME_DIR");
+	if (env && *env)
+		snprintf(path, sizeof(path), "%s", env);
+	else
+		snprintf(path, sizeof(path), "%s/rwm-profile.csv", dir && *dir ? dir : "/tmp");
+
+	FILE *f = fopen(path, "w");
+	if (!f) {
+		wlr_log(WLR_ERROR, "Failed to open %s: %s", path, strerror(errno));
+		return;
+	}
+	fprintf(f, "frame,output,start_us,cpu_us");
+	for (int i = 0; i < PHASE_COUNT; i++) fprintf(f, ",%s_us", phase_names[i]);
+	fprintf(f, ",gpu_us,present_us,delay_us,missed,draw_calls,instances,uploads\n");
+
+	uint64_t first = srv->profile_seq >= PROF_HISTORY ? srv->profile_seq - PROF_HISTORY + 1 : 1;
+	for (uint64_t seq = first; seq <= srv->profile_seq; seq++) {
+		const struct frame_profile *prof = profile_entry(srv, seq);
+		if (!prof) continue;
+		fprintf(f, "%" PRIu64 ",%s,%" PRIu64 ",%" PRIu32, prof->seq, prof->output,
+			prof->start_ns / 1000, prof->cpu_total_us);
+		for (int i = 0; i < PHASE_COUNT; i++) fprintf(f, ",%" PRIu32, prof->cpu_us[i]);
+		fprintf(f, ",%" PRId32 ",%" PRId32 ",%" PRIu32 ",%d,%u,%u,%u\n", prof->gpu_us,
+			prof->present_us, prof->delay_us, prof->missed, prof->draw_calls, prof->instances, prof->uploads);
+	}
+	if (fclose(f) != 0) {
+		wlr_log(WLR_ERROR, "Failed to write %s: %s", path, strerror(errno));
+		return;
+	}
+	add_notification(srv, "Frame profile saved", path);
+}
+
+static int profile_signal_handler(int sig, void *data) {
+	(void)sig;
+	write_profile_log(data);
+	return 0;
+}
+
+/* ========================================================================== */
+/* Benchmark mode                                                              */
+/* ========================================================================== */
+
+/* RWM_BENCH runs a client command (normally rwm-bench.elf, see ./build.sh bench),
+   drives scripted input while it runs and prints a report once it exits or rwm
+   gets SIGTERM/SIGINT. */
+
+static int bench_input_handler(void *data) {
+	struct server *srv = data;
+	struct output *output = primary_output(srv);
+	uint32_t tick = srv->bench.input_tick++;
+	uint32_t cycle = tick % (4 * BENCH_INPUT_HZ);
+	if (output) {
+		/* The pointer sweeps a Lissajous curve over the primary output */
+		struct wlr_box box = output_box(output);
+		double t = tick / (double)BENCH_INPUT_HZ;
+		uint64_t now = now_ns();
+		wlr_cursor_warp_closest(srv->cursor, NULL,
+			box.x + box.width * (0.5 + 0.4 * sin(t * 1.3)),
+			box.y + box.height * (0.5 + 0.4 * sin(t * 1.7)));
+		queue_cursor_motion(srv, (uint32_t)(now / 1000000));
+	}
+
+	/* Every second Super+Tab; for one second in four the focused view is
+	   dragged. Press and release take the steps server_cursor_button does. */
+	if (tick % BENCH_INPUT_HZ == 0)
+		handle_keybinding(srv, XKB_KEY_Tab, true, false);
+	if (cycle == BENCH_INPUT_HZ / 2 && srv->focused_view) {
+		flush_cursor_motion(srv);
+		begin_grab(srv->focused_view, 0);
+	} else if (cycle == BENCH_INPUT_HZ * 3 / 2) {
+		flush_cursor_motion(srv);
+		srv->pressed.type = PRESSED_NONE;
+		end_grab(srv);
+	}
+
+	wl_event_source_timer_update(srv->bench.input_timer, 1000 / BENCH_INPUT_HZ);
+	return 0;
+}
+
+static int bench_sigchld_handler(int sig, void *data) {
+	struct server *srv = data;
+	(void)sig;
+	pid_t pid;
+	while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+		if (pid != srv->bench.pid) continue;
+		srv->bench.pid = 0;
+		wl_display_terminate(srv->wl_display);
+	}
+	return 0;
 }
 
+static int bench_sigterm_handler(int sig, void *data) {
+	struct server *srv = data;
+	(void)sig;
+	wl_display_terminate(srv->wl_display);
+	return 0;
+}
+
+static void bench_start(struct server *srv, struct wl_event_loop *loop, const char *cmd) {
+	srv->bench.active = true;
+	srv->bench.start_ns = now_ns();
+	getrusage(RUSAGE_SELF, &srv->bench.start_usage);
+	srv->bench.sigchld = wl_event_loop_add_signal(loop, SIGCHLD, bench_sigchld_handler, srv);
+	srv->bench.sigterm = wl_event_loop_add_signal(loop, SIGTERM, bench_sigterm_handler, srv);
+	srv->bench.sigint = wl_event_loop_add_signal(loop, SIGINT, bench_sigterm_handler, srv);
+	srv->bench.input_timer = wl_event_loop_add_timer(loop, bench_input_handler, srv);
+	if (srv->bench.input_timer) wl_event_source_timer_update(srv->bench.input_timer, 1);
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		sigset_t set;
+		sigemptyset(&set);
+		sigprocmask(SIG_SETMASK, &set, NULL);
+		execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+		_exit(127);
+	}
+	if (pid < 0)
+		wlr_log(WLR_ERROR, "Failed to start RWM_BENCH command: %s", strerror(errno));
+	srv->bench.pid = pid > 0 ? pid : 0;
+}
+
+static void bench_record_frame(struct server *srv, const struct frame_profile *prof) {
+	if (!srv->bench.active) return;
+	uint32_t bucket = prof->cpu_total_us / BENCH_HIST_US;
+	srv->bench.hist[bucket < BENCH_HIST_BUCKETS ? bucket : BENCH_HIST_BUCKETS - 1]++;
+	srv->bench.frames++;
+}
+
+/* Upper bound in ms of the histogram bucket holding the p-th fraction of frames */
+static double bench_percentile(const struct server *srv, double p) {
+	uint64_t target = (uint64_t)(p * (double)(srv->bench.frames - 1));
+	uint64_t seen = 0;
+	for (int i = 0; i < BENCH_HIST_BUCKETS; i++) {
+		seen += srv->bench.hist[i];
+		if (seen > target) return (i + 1) * BENCH_HIST_US / 1000.0;
+	}
+	return BENCH_HIST_BUCKETS * BENCH_HIST_US / 1000.0;
+}
+
+static inline double timeval_s(const struct timeval *tv) {
+	return (double)tv->tv_sec + (double)tv->tv_usec / 1e6;
+}
+
+static void bench_finish(struct server *srv) {
+	uint64_t end_ns = now_ns();
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	double secs = (double)(end_ns - srv->bench.start_ns) / 1e9;
+	double user = timeval_s(&usage.ru_utime) - timeval_s(&srv->bench.start_usage.ru_utime);
+	double sys = timeval_s(&usage.ru_stime) - timeval_s(&srv->bench.start_usage.ru_stime);
+
+	if (srv->bench.pid > 0) {
+		kill(srv->bench.pid, SIGTERM);
+		waitpid(srv->bench.pid, NULL, 0);
+	}
+	if (srv->bench.input_timer) wl_event_source_remove(srv->bench.input_timer);
+	if (srv->bench.sigchld) wl_event_source_remove(srv->bench.sigchld);
+	if (srv->bench.sigterm) wl_event_source_remove(srv->bench.sigterm);
+	if (srv->bench.sigint) wl_event_source_remove(srv->bench.sigint);
+
+	if (secs <= 0.0) secs = 1e-9;
+	double frames = (double)srv->bench.frames;
+	printf("rwm: %.1f s, %" PRIu64 " frames (%.1f/s), %" PRIu64 " missed\n",
+		secs, srv->bench.frames, frames / secs, srv->bench.missed);
+	if (srv->bench.frames)
+		printf("rwm: frame cpu ms p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n",
+			bench_percentile(srv, 0.5), bench_percentile(srv, 0.9),
+			bench_percentile(srv, 0.99), bench_percentile(srv, 1.0));
+	if (srv->bench.gpu_frames)
+		printf("rwm: frame gpu ms avg %.2f\n",
+			(double)srv->bench.gpu_us / (double)srv->bench.gpu_frames / 1000.0);
+	printf("rwm: %" PRIu64 " client commits (%.1f/s)\n",
+		srv->bench.commits, (double)srv->bench.commits / secs);
+	printf("rwm: cpu %.1f%% (user %.2f s, sys %.2f s)\n",
+		100.0 * (user + sys) / secs, user, sys);
+
+	struct sysinfo_bench parse;
+	sysinfo_bench(&parse);
+	if (parse.mem_scan_ns >= 0.0)
+		printf("rwm: /proc/meminfo parse ns sscanf %.0f  scan %.0f\n", parse.mem_sscanf_ns, parse.mem_scan_ns);
+	if (parse.stat_scan_ns >= 0.0)
+		printf("rwm: /proc/stat parse ns scan %.0f (%d cpus)\n", parse.stat_scan_ns, parse.cpus);
+	fflush(stdout);
+}
+
+/* ========================================================================== */
+/* Output                                                                      */
+/* ========================================================================== */
+
 static void render_view(struct server *srv, struct view *view) {
 	update_geometry(view);
-	if (view->frame_h > view->content_h) {
-		render_window_frame(srv, view, view->content_w, view->content_h, srv->focused_view == view);
-		flush_boxes(srv);
-	}
+	if (view->frame_h > view->content_h)
+		render_view_frame(srv, view);
 	struct surface_render_data rdata = { .view = view };
 	wlr_xdg_surface_for_each_surface(view->xdg_toplevel->base,
 		render_surface_iterator, &rdata);
 }
 
-static void render_cursor_trail(struct server *srv, struct wlr_output *wlr_output) {
-	double cx = srv->cursor->x;
-	double cy = srv->cursor->y;
-	double vx = cx - srv->prev_cursor_x;
-	double vy = cy - srv->prev_cursor_y;
-	srv->prev_cursor_x = cx;
-	srv->prev_cursor_y = cy;
+/* Paint the background where it is damaged and not hidden behind opaque content,
+   from the cache in BG_CACHED and BG_STATIC mode */
+static void render_background(struct server *srv, struct output *output,
+		const pixman_region32_t *damage, const pixman_region32_t *opaque) {
+	struct wlr_output *wlr_output = output->wlr_output;
+	pixman_region32_t region;
+	pixman_region32_init(&region);
+	pixman_region32_subtract(&region, damage, opaque);
+
+	if (pixman_region32_not_empty(&region)) {
+		bool ready;
+		if (srv->bg_mode != BG_ANIMATED && update_background_cache(srv, output))
+			ready = use_background_cache(srv, output);
+		else
+			ready = use_background_shader(srv, wlr_output->width, wlr_output->height, 1.0f);
+
+		int nrects = 0;
+		const pixman_box32_t *rects = pixman_region32_rectangles(&region, &nrects);
+		if (nrects > BG_MAX_RECTS) {
+			rects = pixman_region32_extents(&region);
+			nrects = 1;
+		}
+		for (int i = 0; ready && i < nrects; i++) {
+			glScissor(rects[i].x1, rects[i].y1, rects[i].x2 - rects[i].x1, rects[i].y2 - rects[i].y1);
+			glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+			srv->stats.draw_calls++;
+		}
+	}
+	pixman_region32_fini(&region);
+
+	const pixman_box32_t *ext = pixman_region32_extents(damage);
+	glScissor(ext->x1, ext->y1, ext->x2 - ext->x1, ext->y2 - ext->y1);
+}
+
+/* Screen area covered by the motion-blurred cursor in the upcoming frame */
+static struct wlr_box cursor_trail_box(const struct server *srv, const struct output *output) {
+	struct wlr_output *wlr_output = output->wlr_output;
+	double cx = srv->cursor->x - output->lx, cy = srv->cursor->y - output->ly;
+	double vx = cx - output->prev_cursor_x, vy = cy - output->prev_cursor_y;
+	double x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+	bool any = false;
+
+	struct wlr_output_cursor *ocursor;
+	wl_list_for_each(ocursor, &wlr_output->cursors, link) {
+		if (!ocursor->enabled || !ocursor->visible || !ocursor->texture)
+			continue;
+		double bx = cx - ocursor->hotspot_x - (vx > 0 ? vx : 0);
+		double by = cy - ocursor->hotspot_y - (vy > 0 ? vy : 0);
+		double bx2 = bx + ocursor->width + fabs(vx);
+		double by2 = by + ocursor->height + fabs(vy);
+		if (!any || bx < x0) x0 = bx;
+		if (!any || by < y0) y0 = by;
+		if (!any || bx2 > x1) x1 = bx2;
+		if (!any || by2 > y1) y1 = by2;
+		any = true;
+	}
+	if (!any) return (struct wlr_box){0};
+
+	/* Pad by a pixel for linear filtering at the edges */
+	x0 = floor(x0) - 1; y0 = floor(y0) - 1;
+	x1 = ceil(x1) + 1; y1 = ceil(y1) + 1;
+	return (struct wlr_box){ (int)x0, (int)y0, (int)(x1 - x0), (int)(y1 - y0) };
+}
+
+static void render_cursor_trail(struct server *srv, struct output *output) {
+	struct wlr_output *wlr_output = output->wlr_output;
+	double cx = srv->cursor->x - output->lx;
+	double cy = srv->cursor->y - output->ly;
+	double vx = cx - output->prev_cursor_x;
+	double vy = cy - output->prev_cursor_y;
+	output->prev_cursor_x = cx;
+	output->prev_cursor_y = cy;
 
 	struct wlr_output_cursor *ocursor;
 	wl_list_for_each(ocursor, &wlr_output->cursors, link) {
@@ -2149,21 +3790,275 @@ static void render_cursor_trail(struct server *srv, struct wlr_output *wlr_outpu
 		glUniform2f(srv->blur_vel_loc, (float)(vx / bw), (float)(vy / bh));
 
 		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+		srv->stats.draw_calls++;
 		glDisableVertexAttribArray(0);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
 }
 
+static void send_view_frame_done(struct view *view, struct timespec *when) {
+	wlr_xdg_surface_for_each_surface(view->xdg_toplevel->base, send_frame_done_iterator, when);
+	view->frame_done_ns = timespec_to_ns(when);
+}
+
+static void frame_pending_iterator(struct wlr_surface *surface, int sx, int sy, void *data) {
+	bool *pending = data;
+	(void)sx; (void)sy;
+	if (!wl_list_empty(&surface->current.frame_callback_list)) *pending = true;
+}
+
+/* Whether any surface of the view waits for a frame callback */
+static bool view_wants_frame(struct view *view) {
+	bool pending = false;
+	wlr_xdg_surface_for_each_surface(view->xdg_toplevel->base, frame_pending_iterator, &pending);
+	return pending;
+}
+
+/* Views that no output shows (occluded, off-output or on another workspace)
+   get frame callbacks only every FRAME_THROTTLE_MS, so they keep making
+   progress without rendering at the refresh rate. Minimized views get none
+   at all until they are restored. */
+static int throttle_timer_handler(void *data) {
+	struct server *srv = data;
+	srv->throttle_armed = false;
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	uint64_t now_ns = timespec_to_ns(&now);
+	bool sent = false;
+	struct view *view = NULL;
+	wl_list_for_each(view, &srv->views, link) {
+		if (view->state == VIEW_MINIMIZED || !view_wants_frame(view)) continue;
+		if (now_ns - view->frame_done_ns < (uint64_t)FRAME_THROTTLE_MS * 1000000u) continue;
+		send_view_frame_done(view, &now);
+		sent = true;
+	}
+	/* Views that keep asking re-arm it through their commits, or right here */
+	if (sent && srv->throttle_timer) {
+		wl_event_source_timer_update(srv->throttle_timer, FRAME_THROTTLE_MS);
+		srv->throttle_armed = true;
+	}
+	return 0;
+}
+
+static void schedule_throttled_frames(struct server *srv) {
+	if (!srv->throttle_timer || srv->throttle_armed) return;
+	wl_event_source_timer_update(srv->throttle_timer, FRAME_THROTTLE_MS);
+	srv->throttle_armed = true;
+}
+
+/* Frame callbacks for the views this output shows; the rest are throttled.
+   Views on other workspaces are throttled by their own commits, or by
+   switch_workspace for those left waiting. */
+static void send_frame_done_views(struct server *srv, const struct output *output) {
+	struct wlr_box bounds = output_box(output);
+	bool throttled = false;
+	struct view *view = NULL;
+	wl_list_for_each(view, &current_workspace(srv)->views, ws_link) {
+		struct wlr_box frame = { view->x, view->y, view->frame_w, view->frame_h }, clipped;
+		bool shown = wlr_box_intersection(&clipped, &frame, &bounds) &&
+			!(view->occluded && view_output(view) == output);
+		if (shown)
+			send_view_frame_done(view, &srv->frame_time);
+		else if (view_wants_frame(view))
+			throttled = true;
+	}
+	if (throttled) schedule_throttled_frames(srv);
+}
+
+/* A fullscreen view whose only surface covers the output pixel for pixel can be
+   shown without composition, as long as nothing of ours has to be drawn on top */
+static struct wlr_surface *scanout_surface(struct server *srv, struct output *output) {
+	struct wlr_output *wlr_output = output->wlr_output;
+	struct view *view = fullscreen_view(srv, output);
+	if (!view)
+		return NULL;
+	if (output == primary_output(srv) &&
+			(srv->find_open || srv->hud_open || !wl_list_empty(&srv->notifications)))
+		return NULL;
+	if (srv->night_mode)
+		return NULL;
+	if (output->cursor_box.width > 0 && !wlr_output->hardware_cursor)
+		return NULL;
+
+	struct wlr_surface *surface = get_surface(view);
+	if (!surface->buffer || !wl_list_empty(&view->xdg_toplevel->base->popups) ||
+			!wl_list_empty(&surface->current.subsurfaces_below) ||
+			!wl_list_empty(&surface->current.subsurfaces_above))
+		return NULL;
+
+	struct wlr_box geo = get_geometry(view);
+	int cx, cy;
+	get_content_pos(view, &cx, &cy);
+	if (cx - geo.x != output->lx || cy - geo.y != output->ly)
+		return NULL;
+	if (surface->current.transform != wlr_output->transform ||
+			surface->current.width != wlr_output->width ||
+			surface->current.height != wlr_output->height ||
+			surface->current.buffer_width != wlr_output->width ||
+			surface->current.buffer_height != wlr_output->height)
+		return NULL;
+	return surface;
+}
+
+/* Adaptive sync follows the focused fullscreen view. Frames are only drawn
+   for damage, so with it enabled the refresh follows the client's commits
+   rather than the fixed vblank cadence. */
+static bool vrr_active(const struct output *output) {
+	return output->wlr_output->adaptive_sync_status == WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED;
+}
+
+static void update_adaptive_sync(struct server *srv, struct output *output, struct wlr_output_state *state) {
+	struct wlr_output *wlr_output = output->wlr_output;
+	bool want = srv->vrr && !output->vrr_failed && wlr_output->adaptive_sync_supported &&
+		fullscreen_view(srv, output);
+	if (want == vrr_active(output)) return;
+
+	struct wlr_output_state test;
+	wlr_output_state_init(&test);
+	wlr_output_state_set_adaptive_sync_enabled(&test, want);
+	bool ok = wlr_output_test_state(wlr_output, &test);
+	wlr_output_state_finish(&test);
+	if (!ok) {
+		if (want) {
+			output->vrr_failed = true;
+			wlr_log(WLR_INFO, "Adaptive sync rejected on %s", wlr_output->name);
+		}
+		return;
+	}
+	wlr_output_state_set_adaptive_sync_enabled(state, want);
+}
+
+static bool try_direct_scanout(struct server *srv, struct output *output) {
+	struct wlr_surface *surface = scanout_surface(srv, output);
+	if (!surface) return false;
+
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+	wlr_output_state_set_buffer(&state, &surface->buffer->base);
+	update_adaptive_sync(srv, output, &state);
+	bool ok = wlr_output_test_state(output->wlr_output, &state);
+	if (ok) {
+		uint64_t commit = ++srv->commit_id;
+		present_view(srv->focused_view, output->wlr_output, commit, true);
+		ok = wlr_output_commit_state(output->wlr_output, &state);
+		output->present_commit = ok ? commit : 0;
+		output->present_commit_seq = output->wlr_output->commit_seq;
+		output->present_frame = 0;
+	}
+	wlr_output_state_finish(&state);
+	return ok;
+}
+
+/* Delayed composition (RWM_RENDER_DELAY) samples the time from frame event
+   to commit, plus the GPU time of the frame before (this one is still running) */
+static void record_render_time(struct output *output, uint32_t cpu_us) {
+	output->render_us[output->render_idx++ % RENDER_HISTORY] = cpu_us + output->gpu_last_us;
+}
+
+/* How long to hold back a frame so it starts one worst recent render time
+   before the next vblank. Client commits arriving meanwhile make this frame
+   instead of the next. 0 renders right away: delaying is off, adaptive sync
+   paces the output, or there is no vblank to predict yet. */
+static int render_delay_ms(struct server *srv, struct output *output) {
+	if (!srv->render_delay || vrr_active(output) || !output->refresh_ns || !output->vblank_ns)
+		return 0;
+	uint32_t max_us = 0;
+	for (int i = 0; i < RENDER_HISTORY; i++)
+		if (output->render_us[i] > max_us) max_us = output->render_us[i];
+	uint64_t budget_ns = ((uint64_t)max_us + RENDER_MARGIN_US) * 1000;
+
+	int nominal_ms = budget_ns < output->refresh_ns ?
+		(int)((output->refresh_ns - budget_ns) / 1000000) : 0;
+	if (nominal_ms != output->logged_delay_ms) {
+		wlr_log(WLR_INFO, "%s: render delay %d ms (render time up to %" PRIu32 " us, refresh %" PRIu32 " us)",
+			output->wlr_output->name, nominal_ms, max_us, output->refresh_ns / 1000);
+		output->logged_delay_ms = nominal_ms;
+	}
+
+	uint64_t now = now_ns();
+	if (now < output->vblank_ns) return 0;
+	uint64_t next = output->vblank_ns +
+		((now - output->vblank_ns) / output->refresh_ns + 1) * output->refresh_ns;
+	uint64_t start = next > budget_ns ? next - budget_ns : 0;
+	return start > now ? (int)((start - now) / 1000000) : 0;
+}
+
+static void render_output(struct output *output);
+
+static int delay_timer_handler(void *data) {
+	struct output *output = data;
+	output->delay_armed = false;
+	render_output(output);
+	return 0;
+}
+
 static void output_frame(struct wl_listener *listener, void *data) {
 	struct output *output = wl_container_of(listener, output, frame);
-	struct wlr_output *wlr_output = output->wlr_output;
 	(void)data;
+	/* Damage arriving while a frame is held back lands in that frame */
+	if (output->delay_armed) return;
+	output->frame_event_ns = now_ns();
+	int delay = render_delay_ms(output->server, output);
+	if (delay > 0 && output->delay_timer) {
+		wl_event_source_timer_update(output->delay_timer, delay);
+		output->delay_armed = true;
+		return;
+	}
+	render_output(output);
+}
+
+static void render_output(struct output *output) {
+	struct wlr_output *wlr_output = output->wlr_output;
 	struct server *srv = output->server;
+	flush_cursor_motion(srv);
 
 	clock_gettime(CLOCK_MONOTONIC, &srv->frame_time);
+	uint64_t frame_ns = timespec_to_ns(&srv->frame_time);
+
+	/* Uncapped background animates every frame; otherwise bg_timer damages it.
+	   Not under adaptive sync, where the fullscreen view sets the pace. */
+	bool bg_every_frame = srv->bg_fps == 0 && background_animating(srv) && !vrr_active(output);
+	if (bg_every_frame) {
+		struct wlr_box full = { 0, 0, wlr_output->width, wlr_output->height };
+		advance_background(srv);
+		output_add_damage(output, &full);
+	}
+	schedule_background(srv);
+
+	/* Repaint where the cursor trail was and where it will be */
+	struct wlr_box cursor_box = cursor_trail_box(srv, output);
+	if (!box_equal(&cursor_box, &output->cursor_box)) {
+		output_add_damage(output, &output->cursor_box);
+		output_add_damage(output, &cursor_box);
+		output->cursor_box = cursor_box;
+	}
+	bool cursor_moving = fabs(srv->cursor->x - output->lx - output->prev_cursor_x) > 0.0 ||
+		fabs(srv->cursor->y - output->ly - output->prev_cursor_y) > 0.0;
+
+	/* Nothing changed: skip rendering, but let clients waiting on frame
+	   callbacks (commits without damage) continue */
+	if (!pixman_region32_not_empty(&output->damage_ring.current)) {
+		send_frame_done_views(srv, output);
+		return;
+	}
+
+	/* Our swapchain buffers are not updated while scanning out, so the first
+	   composited frame afterwards has to repaint everything */
+	if (try_direct_scanout(srv, output)) {
+		pixman_region32_clear(&output->damage_ring.current);
+		output->scanout = true;
+		send_frame_done_views(srv, output);
+		return;
+	}
+	if (output->scanout) {
+		struct wlr_box full = { 0, 0, wlr_output->width, wlr_output->height };
+		output_add_damage(output, &full);
+		output->scanout = false;
+	}
 
 	struct wlr_output_state state;
 	wlr_output_state_init(&state);
+	update_adaptive_sync(srv, output, &state);
 
 	struct wlr_render_pass *pass = wlr_output_begin_render_pass(wlr_output, &state, NULL);
 	if (!pass) {
@@ -2171,9 +4066,30 @@ static void output_frame(struct wl_listener *listener, void *data) {
 		return;
 	}
 
-	srv->output = wlr_output;
-
-	render_shader_background(srv, wlr_output->width, wlr_output->height);
+	memset(&srv->stats, 0, sizeof(srv->stats));
+	struct frame_profile *prof = begin_profile(srv, output, frame_ns);
+	prof->delay_us = (uint32_t)((frame_ns - output->frame_event_ns) / 1000);
+	begin_gpu_query(srv, output, prof->seq);
+	uint64_t phase_ns = now_ns();
+
+	/* Damage accumulated since this buffer was last rendered (buffer age) */
+	pixman_region32_t damage;
+	pixman_region32_init(&damage);
+	wlr_damage_ring_rotate_buffer(&output->damage_ring, state.buffer, &damage);
+	pixman_region32_intersect_rect(&damage, &damage, 0, 0,
+		(unsigned int)wlr_output->width, (unsigned int)wlr_output->height);
+	wlr_output_state_set_damage(&state, &damage);
+
+	const pixman_box32_t *ext = pixman_region32_extents(&damage);
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(ext->x1, ext->y1, ext->x2 - ext->x1, ext->y2 - ext->y1);
+
+	pixman_region32_t opaque;
+	pixman_region32_init(&opaque);
+	cull_views(srv, output, &damage, &opaque);
+	render_background(srv, output, &damage, &opaque);
+	pixman_region32_fini(&opaque);
+	profile_phase(prof, PHASE_BACKGROUND, &phase_ns);
 
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
@@ -2182,18 +4098,29 @@ static void output_frame(struct wl_listener *listener, void *data) {
 	if (!srv->ui_prog) {
 		init_ui_shader(srv);
 		if (!srv->ui_prog) {
+			glDisable(GL_SCISSOR_TEST);
+			end_gpu_query(srv);
 			wlr_render_pass_submit(pass);
 			wlr_output_commit_state(wlr_output, &state);
 			wlr_output_state_finish(&state);
+			pixman_region32_fini(&damage);
 			return;
 		}
 	}
 	if (!srv->glyph_atlas)
 		init_glyph_atlas(srv);
 	srv->batch_n = 0;
+	srv->tex_slot_n = 1;
 
+	/* UI geometry is queued in layout coordinates */
+	if (srv->ext_prog) {
+		glUseProgram(srv->ext_prog);
+		glUniform2f(srv->ext_res_loc, (float)wlr_output->width, (float)wlr_output->height);
+		glUniform2f(srv->ext_origin_loc, (float)output->lx, (float)output->ly);
+	}
 	glUseProgram(srv->ui_prog);
 	glUniform2f(srv->res_loc, (float)wlr_output->width, (float)wlr_output->height);
+	glUniform2f(srv->origin_loc, (float)output->lx, (float)output->ly);
 	setup_ui_attributes(srv);
 
 	if (srv->glyph_atlas) {
@@ -2202,25 +4129,93 @@ static void output_frame(struct wl_listener *listener, void *data) {
 	}
 
 	struct view *view = NULL;
-	wl_list_for_each_reverse(view, &srv->views, link) {
-		if (!view_is_visible(view, srv)) continue;
+	uint64_t commit = ++srv->commit_id;
+	wl_list_for_each_reverse(view, &current_workspace(srv)->views, ws_link) {
+		if (view->culled) continue;
 		render_view(srv, view);
-		wlr_xdg_surface_for_each_surface(view->xdg_toplevel->base, send_frame_done_iterator, &srv->frame_time);
+		present_view(view, wlr_output, commit, false);
 	}
-
-	if (!srv->focused_view || srv->focused_view->state != VIEW_FULLSCREEN)
-		render_taskbar(srv);
-	render_find_overlay(srv);
-	render_notifications(srv);
+	profile_phase(prof, PHASE_VIEWS, &phase_ns);
+
+	if (taskbar_visible(srv, output))
+		render_taskbar(srv, output);
+	profile_phase(prof, PHASE_TASKBAR, &phase_ns);
+	if (output == primary_output(srv)) {
+		render_find_overlay(srv, output);
+		render_notifications(srv, output);
+		render_hud(srv, output);
+	}
+	profile_phase(prof, PHASE_OVERLAYS, &phase_ns);
 
 	flush_boxes(srv);
-	render_cursor_trail(srv, wlr_output);
+	render_cursor_trail(srv, output);
 	for (GLuint i = 0; i < 4; i++) glDisableVertexAttribArray(i);
+	profile_phase(prof, PHASE_FLUSH, &phase_ns);
 	render_night_filter(srv, wlr_output->width, wlr_output->height);
+	profile_phase(prof, PHASE_NIGHT, &phase_ns);
+	glDisable(GL_SCISSOR_TEST);
+	end_gpu_query(srv);
 	wlr_render_pass_submit(pass);
-	wlr_output_commit_state(wlr_output, &state);
+	bool committed = wlr_output_commit_state(wlr_output, &state);
 	wlr_output_state_finish(&state);
-	wlr_output_schedule_frame(wlr_output);
+	pixman_region32_fini(&damage);
+	profile_phase(prof, PHASE_COMMIT, &phase_ns);
+
+	/* The present event fills in the latency of this commit */
+	output->commit_ns = phase_ns;
+	output->present_commit_seq = wlr_output->commit_seq;
+	output->present_frame = committed ? prof->seq : 0;
+	output->present_commit = committed ? commit : 0;
+	prof->missed = !committed;
+	prof->cpu_total_us = (uint32_t)((phase_ns - frame_ns) / 1000);
+	record_render_time(output, prof->cpu_total_us);
+	prof->draw_calls = srv->stats.draw_calls;
+	prof->instances = srv->stats.instances;
+	prof->uploads = srv->stats.uploads;
+	bench_record_frame(srv, prof);
+	wlr_log(WLR_DEBUG, "%s: %u draw calls, %u instances, %u uploads", wlr_output->name,
+		srv->stats.draw_calls, srv->stats.instances, srv->stats.uploads);
+
+	send_frame_done_views(srv, output);
+
+	/* Keep the loop running only while something animates; one more frame
+	   after the cursor stops lets the trail collapse. Anything else that
+	   changes schedules its own frame through damage or a client commit. */
+	if (cursor_moving || bg_every_frame)
+		wlr_output_schedule_frame(wlr_output);
+}
+
+static void output_present(struct wl_listener *listener, void *data) {
+	struct output *output = wl_container_of(listener, output, present);
+	const struct wlr_output_event_present *event = data;
+	if (event->presented && event->refresh > 0) {
+		output->vblank_ns = timespec_to_ns(&event->when);
+		output->refresh_ns = (uint32_t)event->refresh;
+	}
+	if (event->commit_seq != output->present_commit_seq) return;
+	uint64_t when = event->presented ? timespec_to_ns(&event->when) : 0;
+	if (output->present_commit) {
+		record_view_latency(output->server, output->present_commit, when);
+		output->present_commit = 0;
+	}
+
+	struct frame_profile *prof = profile_entry(output->server, output->present_frame);
+	output->present_frame = 0;
+	if (!prof) return;
+	if (event->presented) {
+		uint64_t latency = when > output->commit_ns ? when - output->commit_ns : 0;
+		prof->present_us = (int32_t)(latency / 1000);
+		prof->missed = event->refresh > 0 && latency > (uint64_t)event->refresh;
+	} else {
+		prof->missed = true;
+	}
+	if (prof->missed) output->server->bench.missed++;
+}
+
+static void output_needs_frame(struct wl_listener *listener, void *data) {
+	struct output *output = wl_container_of(listener, output, needs_frame);
+	(void)data;
+	wlr_output_schedule_frame(output->wlr_output);
 }
 
 static void output_request_state(struct wl_listener *listener, void *data) {
@@ -2233,20 +4228,15 @@ static void output_request_state(struct wl_listener *listener, void *data) {
 	int old_h = wlr_output->height;
 
 	wlr_output_commit_state(wlr_output, event->state);
+	damage_output_whole(output);
 
 	if (wlr_output->width != old_w || wlr_output->height != old_h) {
-		srv->output = wlr_output;
-
-		int uw, uh;
-		get_usable_area(srv, &uw, &uh);
-
-		/* Resize maximized/fullscreen views to new output size */
+		/* Resize maximized/fullscreen views on this output to its new size */
 		struct view *view = NULL;
 		wl_list_for_each(view, &srv->views, link) {
-			if (view->state == VIEW_MAXIMIZED)
-				place_view(view, 0, 0, uw, uh);
-			else if (view->state == VIEW_FULLSCREEN)
-				place_view(view, 0, 0, uw, uh + BAR_HEIGHT);
+			if ((view->state == VIEW_MAXIMIZED || view->state == VIEW_FULLSCREEN) &&
+					view_output(view) == output)
+				fill_output(view, output);
 		}
 	}
 }
@@ -2256,9 +4246,17 @@ static void output_destroy_handler(struct wl_listener *listener, void *data) {
 	struct server *srv = output->server;
 	(void)data;
 	wl_list_remove(&output->frame.link);
+	wl_list_remove(&output->present.link);
+	wl_list_remove(&output->needs_frame.link);
 	wl_list_remove(&output->request_state.link);
 	wl_list_remove(&output->destroy.link);
 	wl_list_remove(&output->link);
+	if (output->delay_timer) wl_event_source_remove(output->delay_timer);
+	wlr_damage_ring_finish(&output->damage_ring);
+	glDeleteFramebuffers(1, &output->bg_fbo);
+	glDeleteTextures(1, &output->bg_tex);
+	glDeleteQueries(1, &output->gpu_query);
+	free(output->taskbar_cache.boxes);
 	free(output);
 	if (wl_list_empty(&srv->outputs))
 		wl_display_terminate(srv->wl_display);
@@ -2301,14 +4299,40 @@ static void server_new_output(struct wl_listener *listener, void *data) {
 	if (!output) return;
 	output->wlr_output = wlr_output;
 	output->server = srv;
+	output->taskbar_dirty = true;
+	wlr_output->data = output;
+	wlr_damage_ring_init(&output->damage_ring);
+	output->delay_timer = wl_event_loop_add_timer(wl_display_get_event_loop(srv->wl_display),
+		delay_timer_handler, output);
 
 	listen(&output->frame, output_frame, &wlr_output->events.frame);
+	listen(&output->present, output_present, &wlr_output->events.present);
+	listen(&output->needs_frame, output_needs_frame, &wlr_output->events.needs_frame);
 	listen(&output->request_state, output_request_state, &wlr_output->events.request_state);
 	listen(&output->destroy, output_destroy_handler, &wlr_output->events.destroy);
 
-	wl_list_insert(&srv->outputs, &output->link);
+	wl_list_insert(srv->outputs.prev, &output->link);
 	wlr_output_layout_add_auto(srv->output_layout, wlr_output);
-	srv->output = wlr_output;
+	struct wlr_box box;
+	wlr_output_layout_get_box(srv->output_layout, wlr_output, &box);
+	output->lx = box.x;
+	output->ly = box.y;
+	damage_output_whole(output);
+}
+
+/* Outputs were added, moved or resized: refresh their cached origins */
+static void layout_change_handler(struct wl_listener *listener, void *data) {
+	struct server *srv = wl_container_of(listener, srv, layout_change);
+	(void)data;
+	struct output *output = NULL;
+	wl_list_for_each(output, &srv->outputs, link) {
+		struct wlr_box box;
+		wlr_output_layout_get_box(srv->output_layout, output->wlr_output, &box);
+		if (wlr_box_empty(&box)) continue;
+		output->lx = box.x;
+		output->ly = box.y;
+	}
+	damage_whole(srv);
 }
 
 /* ========================================================================== */
@@ -2323,22 +4347,35 @@ static void xdg_toplevel_map(struct wl_listener *listener, void *data) {
 	if (client) wl_client_get_credentials(client, &view->pid, NULL, NULL);
 	update_title(view);
 
-	/* Center the window on the output */
-	const struct server *srv = view->server;
+	/* Center the window on the output under the cursor */
+	struct server *srv = view->server;
 	int frame_w, frame_h;
 	get_frame_size(view, &frame_w, &frame_h);
-	view->x = (srv->output->width - frame_w) / 2;
-	view->y = (srv->output->height - frame_h) / 2;
+	struct output *output = output_at(srv, srv->cursor->x, srv->cursor->y);
+	if (output) {
+		struct wlr_box area = usable_area(output);
+		view->x = area.x + (area.width - frame_w) / 2;
+		view->y = area.y + (area.height - frame_h) / 2;
+	}
 
-	wl_list_insert(&view->server->views, &view->link);
-	wl_list_insert(view->server->taskbar_views.prev, &view->taskbar_link);
+	struct workspace *ws = &srv->workspaces[view->workspace];
+	wl_list_insert(&srv->views, &view->link);
+	wl_list_insert(&ws->views, &view->ws_link);
+	wl_list_insert(ws->taskbar.prev, &view->taskbar_link);
+	view->stack_seq = ++srv->stack_seq;
+	index_view(view);
 	focus_view(view, get_surface(view));
 }
 
 static void xdg_toplevel_unmap(struct wl_listener *listener, void *data) {
 	struct view *view = wl_container_of(listener, view, unmap);
 	(void)data;
+	damage_view(view);
+	damage_taskbar(view->server);
+	unindex_view(view);
 	wl_list_remove(&view->link);
+	wl_list_remove(&view->ws_link);
+	wl_list_init(&view->ws_link);
 	wl_list_remove(&view->taskbar_link);
 	defocus_view(view->server, view);
 }
@@ -2347,6 +4384,7 @@ static void xdg_toplevel_destroy(struct wl_listener *listener, void *data) {
 	struct view *view = wl_container_of(listener, view, destroy);
 	(void)data;
 	detach_view(view->server, view);
+	unindex_view(view);
 
 	wl_list_remove(&view->map.link);
 	wl_list_remove(&view->unmap.link);
@@ -2356,20 +4394,56 @@ static void xdg_toplevel_destroy(struct wl_listener *listener, void *data) {
 	wl_list_remove(&view->request_resize.link);
 	wl_list_remove(&view->request_maximize.link);
 	wl_list_remove(&view->request_fullscreen.link);
+	wl_list_remove(&view->set_title.link);
 	wl_list_remove(&view->decoration_destroy.link);
+	free(view->frame_cache.boxes);
 	free(view);
 }
 
+static void xdg_toplevel_set_title(struct wl_listener *listener, void *data) {
+	struct view *view = wl_container_of(listener, view, set_title);
+	(void)data;
+	update_title(view);
+	if (!get_surface(view)->mapped) return;
+	struct frame_insets fi = get_insets(view);
+	struct wlr_box title_bar = { view->x, view->y, view->frame_w, fi.top };
+	damage_box(view->server, &title_bar);
+	damage_taskbar(view->server);
+}
+
 static void xdg_toplevel_commit(struct wl_listener *listener, void *data) {
 	struct view *view = wl_container_of(listener, view, commit);
 	const struct wlr_xdg_surface *xdg = view->xdg_toplevel->base;
 	(void)data;
+	view->server->bench.commits++;
 	if (xdg->initial_commit && xdg->initialized) {
 		if (view->decoration)
 			wlr_xdg_toplevel_decoration_v1_set_mode(view->decoration,
 				WLR_XDG_TOPLEVEL_DECORATION_V1_MODE_SERVER_SIDE);
 		wlr_xdg_toplevel_set_size(view->xdg_toplevel, 0, 0);
 	}
+
+	if (!xdg->surface->mapped) return;
+	if (view->server->grabbed_view == view && view->server->resize_edges) {
+		if (view->resize_serial && (int32_t)(xdg->current.configure_serial - view->resize_serial) >= 0)
+			view->resize_serial = 0;
+		anchor_resize(view);
+		send_resize(view, false);
+	}
+	index_view(view);
+	if (!view_is_visible(view, view->server)) {
+		if (view->state != VIEW_MINIMIZED) schedule_throttled_frames(view->server);
+		return;
+	}
+	if (!view->latency.pending_ns) view->latency.pending_ns = now_ns();
+	update_geometry(view);
+	struct wlr_box box = { view->x, view->y, view->frame_w, view->frame_h };
+	if (box_equal(&box, &view->damaged_box))
+		damage_view_surfaces(view);
+	else
+		damage_view(view);
+	/* Frame callbacks must fire even for commits without damage */
+	schedule_frames(view->server);
 }
 
 static void xdg_toplevel_request_move_handler(struct wl_listener *listener, void *data) {
@@ -2388,7 +4462,7 @@ static void xdg_toplevel_request_maximize_handler(struct wl_listener *listener,
 	struct view *view = wl_container_of(listener, view, request_maximize);
 	(void)data;
 	if (get_surface(view)->mapped)
-		toggle_state(view->server, view, VIEW_MAXIMIZED);
+		toggle_state(view, VIEW_MAXIMIZED);
 }
 
 static void xdg_toplevel_request_fullscreen_handler(struct wl_listener *listener, void *data) {
@@ -2397,7 +4471,7 @@ static void xdg_toplevel_request_fullscreen_handler(struct wl_listener *listener
 	bool want = view->xdg_toplevel->requested.fullscreen;
 	bool is = view->state == VIEW_FULLSCREEN;
 	if (want != is && (is || get_surface(view)->mapped))
-		toggle_state(view->server, view, VIEW_FULLSCREEN);
+		toggle_state(view, VIEW_FULLSCREEN);
 }
 
 static void decoration_handle_destroy(struct wl_listener *listener, void *data) {
@@ -2432,6 +4506,7 @@ static void server_new_xdg_toplevel(struct wl_listener *listener, void *data) {
 
 	xdg_surface->data = view;
 	wl_list_init(&view->decoration_destroy.link);
+	wl_list_init(&view->ws_link);
 
 	listen(&view->map, xdg_toplevel_map, &xdg_surface->surface->events.map);
 	listen(&view->unmap, xdg_toplevel_unmap, &xdg_surface->surface->events.unmap);
@@ -2441,35 +4516,64 @@ static void server_new_xdg_toplevel(struct wl_listener *listener, void *data) {
 	listen(&view->request_resize, xdg_toplevel_request_resize_handler, &toplevel->events.request_resize);
 	listen(&view->request_maximize, xdg_toplevel_request_maximize_handler, &toplevel->events.request_maximize);
 	listen(&view->request_fullscreen, xdg_toplevel_request_fullscreen_handler, &toplevel->events.request_fullscreen);
+	listen(&view->set_title, xdg_toplevel_set_title, &toplevel->events.set_title);
 }
 
 struct popup_data {
+	struct server *server;
 	struct wlr_xdg_popup *popup;
+	struct wlr_box geometry; /* last seen, popups can move without unmapping */
 	struct wl_listener commit;
 	struct wl_listener destroy;
 };
 
+/* Walk up the popup chain to the toplevel view that owns a surface */
+static struct view *view_from_surface(struct wlr_surface *surface) {
+	while (surface) {
+		struct wlr_xdg_surface *xdg = wlr_xdg_surface_try_from_wlr_surface(surface);
+		if (!xdg) return NULL;
+		if (xdg->role == WLR_XDG_SURFACE_ROLE_TOPLEVEL) return xdg->data;
+		if (xdg->role != WLR_XDG_SURFACE_ROLE_POPUP || !xdg->popup) return NULL;
+		surface = xdg->popup->parent;
+	}
+	return NULL;
+}
+
 static void xdg_popup_commit(struct wl_listener *listener, void *data) {
 	struct popup_data *pd = wl_container_of(listener, pd, commit);
 	(void)data;
 	if (pd->popup->base->initial_commit)
 		wlr_xdg_surface_schedule_configure(pd->popup->base);
+
+	/* Popups may extend past their view's frame, so moves repaint everything */
+	struct wlr_box geo = pd->popup->current.geometry;
+	if (!pd->popup->base->surface->mapped || !box_equal(&geo, &pd->geometry)) {
+		pd->geometry = geo;
+		damage_whole(pd->server);
+		return;
+	}
+	struct view *view = view_from_surface(pd->popup->parent);
+	if (view && view_is_visible(view, pd->server))
+		damage_view_surfaces(view);
+	schedule_frames(pd->server);
 }
 
 static void xdg_popup_destroy(struct wl_listener *listener, void *data) {
 	struct popup_data *pd = wl_container_of(listener, pd, destroy);
 	(void)data;
+	damage_whole(pd->server);
 	wl_list_remove(&pd->commit.link);
 	wl_list_remove(&pd->destroy.link);
 	free(pd);
 }
 
 static void server_new_xdg_popup(struct wl_listener *listener, void *data) {
+	struct server *srv = wl_container_of(listener, srv, new_xdg_popup);
 	struct wlr_xdg_popup *popup = data;
-	(void)listener;
 
 	struct popup_data *pd = calloc(1, sizeof(*pd));
 	if (!pd) return;
+	pd->server = srv;
 	pd->popup = popup;
 
 	listen(&pd->commit, xdg_popup_commit, &popup->base->surface->events.commit);
@@ -2487,7 +4591,16 @@ int main(void) {
 	if (!server.wl_display) return 1;
 	server.workspace = 1;
 
-	server.backend = wlr_backend_autocreate(wl_display_get_event_loop(server.wl_display), NULL);
+	struct wl_event_loop *loop = wl_display_get_event_loop(server.wl_display);
+	const char *headless = getenv("RWM_HEADLESS");
+	if (headless) {
+		/* No GPU or display needed: wlroots may fall back to llvmpipe */
+		setenv("WLR_RENDERER", "gles2", 0);
+		setenv("WLR_RENDERER_ALLOW_SOFTWARE", "1", 0);
+		server.backend = wlr_headless_backend_create(loop);
+	} else {
+		server.backend = wlr_backend_autocreate(loop, NULL);
+	}
 	if (!server.backend) return 1;
 	server.renderer = wlr_renderer_autocreate(server.backend);
 	if (!server.renderer) return 1;
@@ -2519,6 +4632,7 @@ int main(void) {
 	wlr_linux_dmabuf_v1_create_with_renderer(server.wl_display, 4, server.renderer);
 	wlr_export_dmabuf_manager_v1_create(server.wl_display);
 	wlr_viewporter_create(server.wl_display);
+	server.presentation = wlr_presentation_create(server.wl_display, server.backend, 2);
 
 	server.relative_pointer_manager = wlr_relative_pointer_manager_v1_create(server.wl_display);
 	server.pointer_constraints = wlr_pointer_constraints_v1_create(server.wl_display);
@@ -2527,14 +4641,20 @@ int main(void) {
 
 	server.output_layout = wlr_output_layout_create(server.wl_display);
 	if (!server.output_layout) return 1;
+	listen(&server.layout_change, layout_change_handler, &server.output_layout->events.change);
 	wlr_xdg_output_manager_v1_create(server.wl_display, server.output_layout);
 
 	wl_list_init(&server.outputs);
 	listen(&server.new_output, server_new_output, &server.backend->events.new_output);
 	listen(&server.backend_destroy, backend_destroy_handler, &server.backend->events.destroy);
+	if (headless) add_headless_outputs(&server, headless);
 
 	wl_list_init(&server.views);
-	wl_list_init(&server.taskbar_views);
+	for (int i = 0; i <= WORKSPACES; i++) {
+		wl_list_init(&server.workspaces[i].views);
+		wl_list_init(&server.workspaces[i].minimized);
+		wl_list_init(&server.workspaces[i].taskbar);
+	}
 	server.xdg_shell = wlr_xdg_shell_create(server.wl_display, 6);
 	if (!server.xdg_shell) return 1;
 	listen(&server.new_xdg_toplevel, server_new_xdg_toplevel, &server.xdg_shell->events.new_toplevel);
@@ -2586,15 +4706,60 @@ int main(void) {
 
 	setenv("WAYLAND_DISPLAY", socket, 1);
 
-	/* Start sysinfo background thread */
+	/* Signal sources must exist before sysinfo_start, so its thread inherits
+	   the blocked mask and never takes the signal itself */
+	server.sigusr1 = wl_event_loop_add_signal(loop, SIGUSR1, profile_signal_handler, &server);
+	const char *bench = getenv("RWM_BENCH");
+	if (bench && *bench) bench_start(&server, loop, bench);
+
+	/* Start sysinfo background thread; the graph samples cpu even when
+	   RWM_STATUS leaves the text item out */
+	server.cpu_graph = env_int("RWM_CPU_GRAPH", 0, 0, 1);
+	if (server.cpu_graph) sysinfo_sample("cpu");
 	sysinfo_start();
 
+	/* Idle timers: frames are only drawn for damage, so time-driven content ticks here */
+	const char *bg_mode = getenv("RWM_BG_MODE");
+	if (bg_mode && !strcmp(bg_mode, "cached"))
+		server.bg_mode = BG_CACHED;
+	else if (bg_mode && !strcmp(bg_mode, "static"))
+		server.bg_mode = BG_STATIC;
+	else if (bg_mode && strcmp(bg_mode, "animated"))
+		wlr_log(WLR_ERROR, "Ignoring RWM_BG_MODE=%s (expected animated, cached or static)", bg_mode);
+	server.bg_scale = env_int("RWM_BG_SCALE", BG_SCALE_DEFAULT, 10, 100);
+	server.bg_fps = env_int("RWM_BG_FPS",
+		server.bg_mode == BG_CACHED ? BG_CACHE_FPS_DEFAULT : BG_FPS_DEFAULT, 0, 1000);
+	server.bg_timer = wl_event_loop_add_timer(loop, bg_timer_handler, &server);
+	server.status_w = -1;
+	sysinfo_get(&server.cached_sysinfo);
+	server.status_notify = sysinfo_notify_fd() >= 0 ? wl_event_loop_add_fd(loop, sysinfo_notify_fd(),
+		WL_EVENT_READABLE, status_notify_handler, &server) : NULL;
+	server.clock_timer = wl_event_loop_add_timer(loop, clock_timer_handler, &server);
+	if (server.clock_timer) wl_event_source_timer_update(server.clock_timer, 1);
+	server.hud_timer = wl_event_loop_add_timer(loop, hud_timer_handler, &server);
+	server.throttle_timer = wl_event_loop_add_timer(loop, throttle_timer_handler, &server);
+	const char *vrr = getenv("RWM_VRR");
+	server.vrr = !vrr || strcmp(vrr, "off");
+	const char *render_delay = getenv("RWM_RENDER_DELAY");
+	server.render_delay = render_delay && !strcmp(render_delay, "auto");
+	if (render_delay && *render_delay && !server.render_delay && strcmp(render_delay, "off"))
+		wlr_log(WLR_ERROR, "Ignoring RWM_RENDER_DELAY=%s (expected auto or off)", render_delay);
+
 	wl_display_run(server.wl_display);
+	if (server.bench.active) bench_finish(&server);
 
 	/* Stop sysinfo background thread */
+	if (server.status_notify) wl_event_source_remove(server.status_notify);
 	sysinfo_stop();
 
+	if (server.bg_timer) wl_event_source_remove(server.bg_timer);
+	if (server.clock_timer) wl_event_source_remove(server.clock_timer);
+	if (server.hud_timer) wl_event_source_remove(server.hud_timer);
+	if (server.throttle_timer) wl_event_source_remove(server.throttle_timer);
+	if (server.sigusr1) wl_event_source_remove(server.sigusr1);
+
 	cleanup_notifications(&server);
+	free_grid(&server);
 	wl_list_remove(&server.cursor_motion.link);
 	wl_list_remove(&server.cursor_motion_absolute.link);
 	wl_list_remove(&server.cursor_button.link);
@@ -2604,6 +4769,7 @@ int main(void) {
 	wl_list_remove(&server.request_cursor.link);
 	wl_list_remove(&server.request_set_selection.link);
 	wl_list_remove(&server.new_output.link);
+	wl_list_remove(&server.layout_change.link);
 	wl_list_remove(&server.backend_destroy.link);
 	wl_list_remove(&server.new_xdg_toplevel.link);
 	wl_list_remove(&server.new_xdg_popup.link);
@@ -2621,6 +4787,7 @@ int main(void) {
 	}
 
 	glDeleteProgram(server.bg_prog);
+	glDeleteProgram(server.bg_blit_prog);
 	glDeleteProgram(server.ui_prog);
 	glDeleteProgram(server.ext_prog);
 	glDeleteProgram(server.blur_prog);
@@ -2629,6 +4796,7 @@ int main(void) {
 	glDeleteTextures(1, &server.bg_noise_tex);
 	glDeleteBuffers(1, &server.quad_vbo);
 	glDeleteBuffers(1, &server.inst_vbo);
+	free(server.batch);
 	FT_Done_Face(server.ft_face);
 	FT_Done_FreeType(server.ft_library);
 
@@ -8,39 +8,115 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <stdatomic.h>
+#include <stdint.h>
 #include <fcntl.h>
-
-/* Paths - these may need adjustment per-system */
-#define BATTERY_PATH      "/sys/class/power_supply/BAT0/capacity"
-#define BACKLIGHT_PATH    "/sys/class/backlight/nvidia_0"
-#define WIFI_IFACE        "wlp0s20f3"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
 
 /* Update intervals in seconds */
 #define INTERVAL_BATTERY    30
 #define INTERVAL_BRIGHTNESS  2
+#define INTERVAL_TEMP        1
 #define INTERVAL_CPU         1
+#define INTERVAL_CPUFREQ     1
 #define INTERVAL_MEM         2
 #define INTERVAL_WIFI        5
 #define INTERVAL_BLUETOOTH  10
 #define INTERVAL_CAPS        1
+#define INTERVAL_LOAD        5
+#define INTERVAL_DISK        2
+#define INTERVAL_NET         2
+#define INTERVAL_NOTIFIED   60  /* fallback for modules with a change notification */
+
+/* Status items shown when RWM_STATUS is unset, in display order */
+#define DEFAULT_MODULES "battery,backlight,temp,cpufreq,mem,wifi,bluetooth,caps,clock"
+
+#define MAX_FDS      160
+#define MAX_DISKS      8
+#define MAX_CPUS     256
+/* A /proc/stat cpu line: "cpuNNN" and ten counters of up to 20 digits */
+#define STAT_LINE_MAX 224
+#define STAT_BUF_SIZE ((MAX_CPUS + 1) * STAT_LINE_MAX)
+#define MAX_POLICIES 128
+
+/* A status item. discover opens the module's fds and returns false if the
+   hardware is absent; such modules are never updated or formatted. A module
+   that sets event_fd is updated as soon as it fires and otherwise only every
+   notified_interval seconds (0 keeps interval, for values that also change
+   without notice). Modules without update (the clock) are formatted from
+   the current time. */
+struct module {
+	const char *name;  /* as listed in RWM_STATUS */
+	bool (*discover)(struct module *m);
+	void (*update)(struct sysinfo *info);
+	int (*format)(const struct sysinfo *info, char *buf, size_t len);
+	int interval;
+	int notified_interval;
+	int event_fd;      /* EPOLLPRI re-reads it as a sysfs attribute, EPOLLIN drains it */
+	uint32_t events;
+	bool listed;       /* discovery was attempted */
+	bool sampled;      /* wanted by sysinfo_sample */
+	bool hidden;       /* sampled only, left out of the status text */
+	uint64_t deadline; /* sysinfo thread only */
+	bool due;
+};
+
+/* epoll tags of the thread's event sources; module i uses EV_MODULE + i */
+enum { EV_WAKE, EV_TIMER, EV_MODULE };
 
 /* Background thread state */
 static pthread_t sysinfo_thread;
 static atomic_bool sysinfo_running;
+
+/* Published values, behind a seqlock so the compositor never blocks: a
+   writer (serialised by info_mutex) makes shared_seq odd while it copies,
+   readers retry if they saw it odd or changed underneath them.
+   shared_gen counts publications that changed the values. */
 static struct sysinfo shared_info;
+static struct sysinfo_profile shared_profile;
+static atomic_uint shared_seq;
+static atomic_uint shared_gen;
+static int notify_fd = -1;  /* eventfd, readable after a publication changed the values */
 static pthread_mutex_t info_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-/* Cached paths (discovered once at startup) */
-static char cached_hwmon_path[280];
-static char cached_bt_rfkill[280];
+/* The thread sleeps in epoll until the next module is due (timer_fd), a
+   brightness request or sysinfo_stop (wake_fd), or a module's event_fd */
+static int epoll_fd = -1;
+static int timer_fd = -1;
+static int wake_fd = -1;
 
-static int read_file_int(const char *path) {
-	FILE *f = fopen(path, "r");
-	if (!f) return -1;
-	int val = -1;
-	if (fscanf(f, "%d", &val) != 1) val = -1;
-	fclose(f);
-	return val;
+/* Modules that passed discovery, in display order; fixed once the thread runs */
+static struct module *active[SYSINFO_MAX_MODULES];
+static int active_count;
+
+/* Every fd the modules opened, closed by sysinfo_stop */
+static int module_fds[MAX_FDS];
+static int module_fd_count;
+
+/* Brightness requests, guarded by info_mutex: the compositor thread only
+   records the latest target and the sysinfo thread writes it, so holding
+   the key writes to sysfs at most once per wakeup */
+static int brightness_raw = -1;      /* last value read or written */
+static int brightness_request = -1;  /* target not yet written, -1 = none */
+
+static int track_fd(int fd) {
+	if (fd < 0) return -1;
+	if (module_fd_count == MAX_FDS) {
+		close(fd);
+		return -1;
+	}
+	module_fds[module_fd_count++] = fd;
+	return fd;
+}
+
+static int open_attr(const char *dir, const char *attr, int flags) {
+	char path[320];
+	snprintf(path, sizeof(path), "%s/%s", dir, attr);
+	return track_fd(open(path, flags | O_CLOEXEC));
 }
 
 static int read_file_str(const char *path, char *buf, size_t len) {
@@ -54,64 +130,34 @@ static int read_file_str(const char *path, char *buf, size_t len) {
 	return 0;
 }
 
-/* Find hwmon path by sensor name (e.g., "coretemp") */
-static int find_hwmon_by_name(const char *name, char *out, size_t len) {
-	DIR *d = opendir("/sys/class/hwmon");
-	if (!d) return -1;
-	const struct dirent *ent;
-	while ((ent = readdir(d))) {
-		if (ent->d_name[0] == '.') continue;
-		char path[278]; /* /sys/class/hwmon/ + NAME_MAX + /name + null */
-		snprintf(path, sizeof(path), "/sys/class/hwmon/%s/name", ent->d_name);
-		char sensor_name[64];
-		if (read_file_str(path, sensor_name, sizeof(sensor_name)) == 0) {
-			if (strcmp(sensor_name, name) == 0) {
-				snprintf(out, len, "/sys/class/hwmon/%s", ent->d_name);
-				closedir(d);
-				return 0;
-			}
-		}
-	}
-	closedir(d);
-	return -1;
+static int read_attr(const char *dir, const char *attr, char *buf, size_t len) {
+	char path[320];
+	snprintf(path, sizeof(path), "%s/%s", dir, attr);
+	return read_file_str(path, buf, len);
 }
 
-/* Find bluetooth rfkill device path */
-static int find_bt_rfkill(char *out, size_t len) {
-	DIR *d = opendir("/sys/class/rfkill");
+/* Find the entry of a sysfs class that rank() scores highest; rank gets
+   the entry's directory and returns 0 to reject it */
+static int find_class_entry(const char *class, int (*rank)(const char *dir),
+		char *out, size_t len) {
+	DIR *d = opendir(class);
 	if (!d) return -1;
+	int best = 0;
 	const struct dirent *ent;
 	while ((ent = readdir(d))) {
 		if (ent->d_name[0] == '.') continue;
-		char path[279];
-		snprintf(path, sizeof(path), "/sys/class/rfkill/%s/type", ent->d_name);
-		char type[32];
-		if (read_file_str(path, type, sizeof(type)) == 0 && strcmp(type, "bluetooth") == 0) {
-			snprintf(out, len, "/sys/class/rfkill/%s", ent->d_name);
-			closedir(d);
-			return 0;
+		char dir[300];
+		snprintf(dir, sizeof(dir), "%s/%s", class, ent->d_name);
+		int r = rank(dir);
+		if (r > best) {
+			best = r;
+			snprintf(out, len, "%s", dir);
 		}
 	}
 	closedir(d);
-	return -1;
+	return best > 0 ? 0 : -1;
 }
 
-/* Persistent file descriptors */
-static int fd_battery = -1;
-static int fd_brightness = -1;
-static int fd_max_brightness = -1;
-static int fd_cpu_temp = -1;
-static int fd_cpu_freq = -1;
-static int fd_meminfo = -1;
-static int fd_wireless = -1;
-static int fd_wifi_state = -1;
-static int fd_bt_soft = -1;
-static int fd_bt_hard = -1;
-static int fd_capslock = -1;
-
-/* Cached max brightness value (doesn't change) */
-static int cached_max_brightness = -1;
-
 /* Read int from open fd (seeks to start first) */
 static int read_fd_int(int fd) {
 	if (fd < 0) return -1;
@@ -135,37 +181,370 @@ static int read_fd_str(int fd, char *buf, size_t len) {
 	return 0;
 }
 
-static int get_battery_percent(void) {
-	return read_fd_int(fd_battery);
+/* Read a whole proc file from open fd; proc may hand it out in pieces */
+static ssize_t read_fd_all(int fd, char *buf, size_t len) {
+	size_t off = 0;
+	while (off < len - 1) {
+		ssize_t n = pread(fd, buf + off, len - 1 - off, (off_t)off);
+		if (n < 0) return -1;
+		if (n == 0) break;
+		off += (size_t)n;
+	}
+	buf[off] = '\0';
+	return (ssize_t)off;
+}
+
+static const char *next_line(const char *line) {
+	line = strchr(line, '\n');
+	return line ? line + 1 : NULL;
+}
+
+/* Unsigned decimal after optional blanks; sscanf costs a format parse and
+   locale lookups per field, this is a handful of instructions per digit */
+static uint64_t parse_u64(const char **p) {
+	const char *s = *p;
+	while (*s == ' ' || *s == '\t') s++;
+	uint64_t v = 0;
+	while (*s >= '0' && *s <= '9') v = v * 10 + (uint64_t)(*s++ - '0');
+	*p = s;
+	return v;
+}
+
+static uint64_t now_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/* KiB/s of a byte counter since the last sample, -1 until there are two */
+struct rate {
+	uint64_t bytes;
+	uint64_t ms;
+};
+
+static int update_rate(struct rate *r, uint64_t bytes) {
+	uint64_t now = now_ms();
+	int kbps = -1;
+	if (r->ms && now > r->ms && bytes >= r->bytes)
+		kbps = (int)((bytes - r->bytes) * 1000 / (now - r->ms) / 1024);
+	r->bytes = bytes;
+	r->ms = now;
+	return kbps;
+}
+
+static int format_rate(int kbps, char *buf, size_t len) {
+	if (kbps >= 1024)
+		return snprintf(buf, len, "%d.%dM", kbps / 1024, kbps % 1024 * 10 / 1024);
+	return snprintf(buf, len, "%dK", kbps);
+}
+
+/* Battery: the first system battery; peripherals report scope Device */
+static int fd_battery = -1;
+
+static int rank_battery(const char *dir) {
+	char buf[32];
+	if (read_attr(dir, "type", buf, sizeof(buf)) < 0 || strcmp(buf, "Battery") != 0) return 0;
+	if (read_attr(dir, "scope", buf, sizeof(buf)) == 0 && strcmp(buf, "Device") == 0) return 0;
+	return 1;
 }
 
-static int get_brightness_percent(void) {
+static bool discover_battery(struct module *m) {
+	(void)m;
+	char dir[300];
+	if (find_class_entry("/sys/class/power_supply", rank_battery, dir, sizeof(dir)) < 0) return false;
+	fd_battery = open_attr(dir, "capacity", O_RDONLY);
+	return fd_battery >= 0;
+}
+
+static void update_battery(struct sysinfo *info) {
+	info->battery_percent = read_fd_int(fd_battery);
+}
+
+static int format_battery(const struct sysinfo *info, char *buf, size_t len) {
+	if (info->battery_percent < 0) return 0;
+	return snprintf(buf, len, "BAT %d%%", info->battery_percent);
+}
+
+/* Backlight: firmware interfaces control the panel best, raw ones least.
+   The device is opened by sysinfo_start for the brightness keys; the
+   module only shows it. */
+static char backlight_dir[300];
+static int fd_brightness = -1;
+static int cached_max_brightness = -1;  /* doesn't change */
+
+static int rank_backlight(const char *dir) {
+	char type[32];
+	if (read_attr(dir, "type", type, sizeof(type)) < 0) return 0;
+	if (strcmp(type, "firmware") == 0) return 3;
+	if (strcmp(type, "platform") == 0) return 2;
+	return 1;
+}
+
+static void open_backlight(void) {
+	if (find_class_entry("/sys/class/backlight", rank_backlight,
+			backlight_dir, sizeof(backlight_dir)) < 0) return;
+	/* Read-write so brightness keys don't reopen it; read-only without permission */
+	fd_brightness = open_attr(backlight_dir, "brightness", O_RDWR);
+	if (fd_brightness < 0) fd_brightness = open_attr(backlight_dir, "brightness", O_RDONLY);
+	cached_max_brightness = read_fd_int(open_attr(backlight_dir, "max_brightness", O_RDONLY));
+	/* The first key press steps from here, before any update ran */
+	brightness_raw = read_fd_int(fd_brightness);
+}
+
+static bool discover_backlight(struct module *m) {
+	if (fd_brightness < 0 || cached_max_brightness <= 0) return false;
+	/* sysfs attributes signal POLLPRI once read; actual_brightness is the
+	   backlight attribute the kernel notifies on */
+	m->event_fd = open_attr(backlight_dir, "actual_brightness", O_RDONLY);
+	m->events = EPOLLPRI;
+	read_fd_int(m->event_fd);
+	return true;
+}
+
+static void update_backlight(struct sysinfo *info) {
 	int cur = read_fd_int(fd_brightness);
-	if (cur < 0 || cached_max_brightness <= 0) return -1;
-	return (cur * 100) / cached_max_brightness;
+	if (cur < 0) {
+		info->brightness_percent = -1;
+		return;
+	}
+	pthread_mutex_lock(&info_mutex);
+	if (brightness_request < 0) brightness_raw = cur;
+	pthread_mutex_unlock(&info_mutex);
+	info->brightness_percent = (cur * 100) / cached_max_brightness;
+}
+
+static int format_backlight(const struct sysinfo *info, char *buf, size_t len) {
+	if (info->brightness_percent < 0) return 0;
+	return snprintf(buf, len, "BRI %d%%", info->brightness_percent);
+}
+
+/* Write the pending brightness request, if any */
+static void apply_brightness_request(void) {
+	pthread_mutex_lock(&info_mutex);
+	int val = brightness_request;
+	brightness_request = -1;
+	pthread_mutex_unlock(&info_mutex);
+	if (val < 0 || fd_brightness < 0) return;
+	char buf[16];
+	int n = snprintf(buf, sizeof(buf), "%d", val);
+	if (pwrite(fd_brightness, buf, (size_t)n, 0) < 0) return;
+}
+
+/* CPU temperature: the first hwmon driver in this list that is present */
+static const char *const hwmon_names[] = { "coretemp", "k10temp", "zenpower", "cpu_thermal", "acpitz" };
+static int fd_cpu_temp = -1;
+
+static int rank_hwmon(const char *dir) {
+	char name[64];
+	if (read_attr(dir, "name", name, sizeof(name)) < 0) return 0;
+	int count = (int)(sizeof(hwmon_names) / sizeof(hwmon_names[0]));
+	for (int i = 0; i < count; i++)
+		if (strcmp(name, hwmon_names[i]) == 0) return count - i;
+	return 0;
 }
 
-static int get_cpu_temp_c(void) {
+static bool discover_temp(struct module *m) {
+	(void)m;
+	char dir[300];
+	if (find_class_entry("/sys/class/hwmon", rank_hwmon, dir, sizeof(dir)) < 0) return false;
+	fd_cpu_temp = open_attr(dir, "temp1_input", O_RDONLY);
+	return fd_cpu_temp >= 0;
+}
+
+static void update_temp(struct sysinfo *info) {
 	int millideg = read_fd_int(fd_cpu_temp);
-	if (millideg < 0) return -1;
-	return millideg / 1000;
+	info->cpu_temp_c = millideg < 0 ? -1 : millideg / 1000;
 }
 
-static int get_cpu_freq_mhz(void) {
-	int khz = read_fd_int(fd_cpu_freq);
-	if (khz < 0) return -1;
-	return khz / 1000;
+static int format_temp(const struct sysinfo *info, char *buf, size_t len) {
+	if (info->cpu_temp_c < 0) return 0;
+	return snprintf(buf, len, "%d°C", info->cpu_temp_c);
 }
 
-static int get_mem_used_percent(void) {
-	if (fd_meminfo < 0) return -1;
-	if (lseek(fd_meminfo, 0, SEEK_SET) < 0) return -1;
+/* CPU utilisation per core from /proc/stat, as busy jiffies since the last
+   sample; the first line is the sum over all cores and is skipped */
+static int fd_stat = -1;
+static uint64_t cpu_busy[MAX_CPUS], cpu_total[MAX_CPUS];
+static uint64_t cpu_prev_busy[MAX_CPUS], cpu_prev_total[MAX_CPUS];
 
-	char content[1024];
-	ssize_t n = read(fd_meminfo, content, sizeof(content) - 1);
-	if (n <= 0) return -1;
-	content[n] = '\0';
+static bool discover_cpu(struct module *m) {
+	(void)m;
+	fd_stat = track_fd(open("/proc/stat", O_RDONLY | O_CLOEXEC));
+	return fd_stat >= 0;
+}
+
+/* Busy and total jiffies of each core; returns how many cores were read */
+static int parse_stat(const char *content, uint64_t *busy, uint64_t *total, int max) {
+	int count = 0;
+	for (const char *p = next_line(content); p && p[0] == 'c' && p[1] == 'p' && p[2] == 'u'; p = next_line(p)) {
+		if (!strchr(p, '\n')) break; /* cut off by the buffer */
+		p += 3;
+		uint64_t cpu = parse_u64(&p);
+		if (cpu >= (uint64_t)max) continue;
+		/* user nice system idle iowait irq softirq steal; guest time is
+		   already part of user */
+		uint64_t sum = 0, idle = 0;
+		for (int i = 0; i < 8; i++) {
+			uint64_t v = parse_u64(&p);
+			sum += v;
+			if (i == 3 || i == 4) idle += v;
+		}
+		busy[cpu] = sum - idle;
+		total[cpu] = sum;
+		if ((int)cpu >= count) count = (int)cpu + 1;
+	}
+	return count;
+}
+
+static void update_cpu(struct sysinfo *info) {
+	static char content[STAT_BUF_SIZE];
+	int count = 0;
+	if (read_fd_all(fd_stat, content, sizeof(content)) > 0)
+		count = parse_stat(content, cpu_busy, cpu_total, MAX_CPUS);
+
+	int min = -1, max = -1, sum = 0, cores = 0;
+	for (int i = 0; i < count; i++) {
+		uint64_t dt = cpu_total[i] - cpu_prev_total[i];
+		uint64_t db = cpu_busy[i] - cpu_prev_busy[i];
+		if (cpu_prev_total[i] && cpu_total[i] > cpu_prev_total[i] && db <= dt) {
+			int util = (int)(db * 100 / dt);
+			if (min < 0 || util < min) min = util;
+			if (util > max) max = util;
+			sum += util;
+			cores++;
+		}
+		cpu_prev_total[i] = cpu_total[i];
+		cpu_prev_busy[i] = cpu_busy[i];
+	}
+	info->cpu_util_min = min;
+	info->cpu_util_max = max;
+	info->cpu_util_avg = cores ? sum / cores : -1;
+	if (!cores) return;
+
+	/* Samples for the taskbar graph, oldest first */
+	if (info->cpu_history_len == SYSINFO_HISTORY)
+		memmove(info->cpu_history, info->cpu_history + 1, SYSINFO_HISTORY - 1);
+	else
+		info->cpu_history_len++;
+	info->cpu_history[info->cpu_history_len - 1] = (unsigned char)info->cpu_util_avg;
+}
+
+static int format_cpu(const struct sysinfo *info, char *buf, size_t len) {
+	if (info->cpu_util_avg < 0) return 0;
+	/* Idlest, mean and busiest core */
+	return snprintf(buf, len, "CPU %d/%d/%d%%",
+		info->cpu_util_min, info->cpu_util_avg, info->cpu_util_max);
+}
+
+/* CPU frequency of each cpufreq policy; hybrid CPUs have one per core type
+   or per core. The average weighs each policy by its number of CPUs. */
+static int fd_policy_freq[MAX_POLICIES];
+static int policy_cpus[MAX_POLICIES];
+static int policy_count;
+
+/* Number of CPUs in a list such as "0-3,8 10" */
+static int count_cpus(const char *list) {
+	int count = 0;
+	const char *p = list;
+	while (*p) {
+		if (*p < '0' || *p > '9') {
+			p++;
+			continue;
+		}
+		uint64_t first = parse_u64(&p), last = first;
+		if (*p == '-') {
+			p++;
+			last = parse_u64(&p);
+		}
+		if (last >= first) count += (int)(last - first + 1);
+	}
+	return count;
+}
+
+static bool discover_cpufreq(struct module *m) {
+	(void)m;
+	const char *base = "/sys/devices/system/cpu/cpufreq";
+	DIR *d = opendir(base);
+	if (!d) return false;
+	const struct dirent *ent;
+	while ((ent = readdir(d)) && policy_count < MAX_POLICIES) {
+		if (strncmp(ent->d_name, "policy", 6) != 0) continue;
+		char dir[300], cpus[256];
+		snprintf(dir, sizeof(dir), "%s/%s", base, ent->d_name);
+		int fd = open_attr(dir, "scaling_cur_freq", O_RDONLY);
+		if (fd < 0) continue;
+		int n = read_attr(dir, "related_cpus", cpus, sizeof(cpus)) == 0 ? count_cpus(cpus) : 0;
+		fd_policy_freq[policy_count] = fd;
+		policy_cpus[policy_count++] = n > 0 ? n : 1;
+	}
+	closedir(d);
+	return policy_count > 0;
+}
+
+static void update_cpufreq(struct sysinfo *info) {
+	int min = -1, max = -1, cpus = 0;
+	long sum = 0;
+	for (int i = 0; i < policy_count; i++) {
+		int khz = read_fd_int(fd_policy_freq[i]);
+		if (khz < 0) continue;
+		int mhz = khz / 1000;
+		if (min < 0 || mhz < min) min = mhz;
+		if (mhz > max) max = mhz;
+		sum += (long)mhz * policy_cpus[i];
+		cpus += policy_cpus[i];
+	}
+	info->cpu_freq_min_mhz = min;
+	info->cpu_freq_max_mhz = max;
+	info->cpu_freq_mhz = cpus ? (int)(sum / cpus) : -1;
+}
+
+static int format_mhz(int mhz, char *buf, size_t len) {
+	if (mhz >= 1000) {
+		int tenths = (mhz + 50) / 100; /* rounded like %.1f, but of bounded width */
+		return snprintf(buf, len, "%d.%dGHz", tenths / 10, tenths % 10);
+	}
+	return snprintf(buf, len, "%dMHz", mhz);
+}
+
+static int format_cpufreq(const struct sysinfo *info, char *buf, size_t len) {
+	if (info->cpu_freq_mhz < 0) return 0;
+	/* One value while all policies agree to the shown precision */
+	if (info->cpu_freq_max_mhz / 100 == info->cpu_freq_min_mhz / 100)
+		return format_mhz(info->cpu_freq_mhz, buf, len);
+	char lo[16], hi[16];
+	format_mhz(info->cpu_freq_min_mhz, lo, sizeof(lo));
+	format_mhz(info->cpu_freq_max_mhz, hi, sizeof(hi));
+	return snprintf(buf, len, "%s-%s", lo, hi);
+}
 
+/* Memory */
+static int fd_meminfo = -1;
+
+static bool discover_mem(struct module *m) {
+	(void)m;
+	fd_meminfo = track_fd(open("/proc/meminfo", O_RDONLY | O_CLOEXEC));
+	return fd_meminfo >= 0;
+}
+
+static int parse_mem_used_percent(const char *content) {
+	uint64_t total = 0, available = 0;
+	for (const char *line = content; line && *line; line = next_line(line)) {
+		const char *p = line;
+		if (strncmp(line, "MemTotal:", 9) == 0) {
+			p += 9;
+			total = parse_u64(&p);
+		} else if (strncmp(line, "MemAvailable:", 13) == 0) {
+			p += 13;
+			available = parse_u64(&p);
+		}
+		if (total && available) break; /* both are near the top */
+	}
+	if (!total || available > total) return -1;
+	return (int)((total - available) * 100 / total);
+}
+
+/* The sscanf parser that parse_mem_used_percent replaced, kept for sysinfo_bench */
+static int parse_mem_used_percent_sscanf(const char *content) {
 	long total = 0, available = 0;
 	const char *line = content;
 	while (line && *line) {
@@ -181,6 +560,48 @@ static int get_mem_used_percent(void) {
 	return (int)(((total - available) * 100) / total);
 }
 
+static void update_mem(struct sysinfo *info) {
+	char content[1024];
+	info->mem_used_percent = read_fd_all(fd_meminfo, content, sizeof(content)) > 0 ?
+		parse_mem_used_percent(content) : -1;
+}
+
+static int format_mem(const struct sysinfo *info, char *buf, size_t len) {
+	if (info->mem_used_percent < 0) return 0;
+	return snprintf(buf, len, "MEM %d%%", info->mem_used_percent);
+}
+
+/* WiFi: the first interface with a wireless directory; link changes
+   arrive over netlink, the signal level has to be polled */
+static char wifi_iface[64];
+static int fd_wireless = -1;
+static int fd_wifi_state = -1;
+
+static int rank_wifi(const char *dir) {
+	char path[320];
+	snprintf(path, sizeof(path), "%s/wireless", dir);
+	return access(path, F_OK) == 0;
+}
+
+static bool discover_wifi(struct module *m) {
+	char dir[300];
+	if (find_class_entry("/sys/class/net", rank_wifi, dir, sizeof(dir)) < 0) return false;
+	snprintf(wifi_iface, sizeof(wifi_iface), "%s", strrchr(dir, '/') + 1);
+	fd_wifi_state = open_attr(dir, "operstate", O_RDONLY);
+	fd_wireless = track_fd(open("/proc/net/wireless", O_RDONLY | O_CLOEXEC));
+	if (fd_wifi_state < 0) return false;
+
+	int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+	struct sockaddr_nl sa = { .nl_family = AF_NETLINK, .nl_groups = RTMGRP_LINK };
+	if (fd >= 0 && bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+		close(fd);
+		fd = -1;
+	}
+	m->event_fd = track_fd(fd);
+	m->events = EPOLLIN;
+	return true;
+}
+
 static int get_wifi_signal_dbm(void) {
 	if (fd_wireless < 0) return -1;
 	if (lseek(fd_wireless, 0, SEEK_SET) < 0) return -1;
@@ -198,12 +619,13 @@ static int get_wifi_signal_dbm(void) {
 		if (line) line++;
 	}
 
+	size_t iface_len = strlen(wifi_iface);
 	while (line && *line) {
-		if (strstr(line, WIFI_IFACE)) {
-			char iface[32];
+		line += strspn(line, " ");
+		if (strncmp(line, wifi_iface, iface_len) == 0 && line[iface_len] == ':') {
 			int status, link;
 			float level;
-			if (sscanf(line, "%31s %d %d %f", iface, &status, &link, &level) >= 4)
+			if (sscanf(line + iface_len + 1, "%d %d %f", &status, &link, &level) >= 3)
 				signal = (int)level;
 			break;
 		}
@@ -213,179 +635,496 @@ static int get_wifi_signal_dbm(void) {
 	return signal;
 }
 
-static bool get_wifi_connected(void) {
+static void update_wifi(struct sysinfo *info) {
 	char state[32];
-	if (read_fd_str(fd_wifi_state, state, sizeof(state)) < 0) return false;
-	return strcmp(state, "up") == 0;
+	info->wifi_connected = read_fd_str(fd_wifi_state, state, sizeof(state)) == 0 &&
+		strcmp(state, "up") == 0;
+	info->wifi_signal_dbm = get_wifi_signal_dbm();
+}
+
+static int format_wifi(const struct sysinfo *info, char *buf, size_t len) {
+	if (!info->wifi_connected) return 0;
+	if (info->wifi_signal_dbm != -1)
+		return snprintf(buf, len, "WiFi %ddBm", info->wifi_signal_dbm);
+	return snprintf(buf, len, "WiFi");
+}
+
+/* Bluetooth: rfkill switch state, /dev/rfkill reports changes */
+static int fd_bt_soft = -1;
+static int fd_bt_hard = -1;
+
+static int rank_bluetooth(const char *dir) {
+	char type[32];
+	return read_attr(dir, "type", type, sizeof(type)) == 0 && strcmp(type, "bluetooth") == 0;
 }
 
-static bool get_bluetooth_on(void) {
+static bool discover_bluetooth(struct module *m) {
+	char dir[300];
+	if (find_class_entry("/sys/class/rfkill", rank_bluetooth, dir, sizeof(dir)) < 0) return false;
+	fd_bt_soft = open_attr(dir, "soft", O_RDONLY);
+	fd_bt_hard = open_attr(dir, "hard", O_RDONLY);
+	m->event_fd = track_fd(open("/dev/rfkill", O_RDONLY | O_NONBLOCK | O_CLOEXEC));
+	m->events = EPOLLIN;
+	return fd_bt_soft >= 0;
+}
+
+static void update_bluetooth(struct sysinfo *info) {
 	int soft = read_fd_int(fd_bt_soft);
 	int hard = read_fd_int(fd_bt_hard);
-	return (soft == 0 && hard == 0);
+	info->bluetooth_on = soft == 0 && hard == 0;
+}
+
+static int format_bluetooth(const struct sysinfo *info, char *buf, size_t len) {
+	return info->bluetooth_on ? snprintf(buf, len, "BT") : 0;
+}
+
+/* Caps Lock: the LED of the first keyboard */
+static int fd_capslock = -1;
+
+static int rank_capslock(const char *dir) {
+	size_t n = strlen(dir);
+	return n > 10 && strcmp(dir + n - 10, "::capslock") == 0;
+}
+
+static bool discover_caps(struct module *m) {
+	(void)m;
+	char dir[300];
+	if (find_class_entry("/sys/class/leds", rank_capslock, dir, sizeof(dir)) < 0) return false;
+	fd_capslock = open_attr(dir, "brightness", O_RDONLY);
+	return fd_capslock >= 0;
+}
+
+static void update_caps(struct sysinfo *info) {
+	info->caps_lock = read_fd_int(fd_capslock) > 0;
+}
+
+static int format_caps(const struct sysinfo *info, char *buf, size_t len) {
+	return info->caps_lock ? snprintf(buf, len, "CAPS") : 0;
+}
+
+/* Load average over the last minute */
+static int fd_loadavg = -1;
+
+static bool discover_load(struct module *m) {
+	(void)m;
+	fd_loadavg = track_fd(open("/proc/loadavg", O_RDONLY | O_CLOEXEC));
+	return fd_loadavg >= 0;
+}
+
+static void update_load(struct sysinfo *info) {
+	char buf[128];
+	int whole, frac;
+	if (read_fd_str(fd_loadavg, buf, sizeof(buf)) < 0 || sscanf(buf, "%d.%d", &whole, &frac) != 2)
+		info->load_avg_x100 = -1;
+	else
+		info->load_avg_x100 = whole * 100 + frac;
 }
 
-static bool get_caps_lock(void) {
-	int brightness = read_fd_int(fd_capslock);
-	return brightness > 0;
+static int format_load(const struct sysinfo *info, char *buf, size_t len) {
+	if (info->load_avg_x100 < 0) return 0;
+	return snprintf(buf, len, "LOAD %d.%02d", info->load_avg_x100 / 100, info->load_avg_x100 % 100);
 }
 
-/* Open all file descriptors */
-static void open_fds(void) {
-	char path[300];
+/* Disk I/O of the block devices backed by hardware; loop, ram, zram and
+   device-mapper devices have no device link and would count twice */
+static char disk_names[MAX_DISKS][32];
+static int disk_count;
+static int fd_diskstats = -1;
+static struct rate disk_rate;
+
+static bool discover_disk(struct module *m) {
+	(void)m;
+	DIR *d = opendir("/sys/block");
+	if (!d) return false;
+	const struct dirent *ent;
+	while ((ent = readdir(d)) && disk_count < MAX_DISKS) {
+		if (ent->d_name[0] == '.' || strlen(ent->d_name) >= sizeof(disk_names[0])) continue;
+		char path[300];
+		snprintf(path, sizeof(path), "/sys/block/%s/device", ent->d_name);
+		if (access(path, F_OK) == 0)
+			snprintf(disk_names[disk_count++], sizeof(disk_names[0]), "%s", ent->d_name);
+	}
+	closedir(d);
+	if (!disk_count) return false;
+	fd_diskstats = track_fd(open("/proc/diskstats", O_RDONLY | O_CLOEXEC));
+	return fd_diskstats >= 0;
+}
+
+static void update_disk(struct sysinfo *info) {
+	char content[16384];
+	if (read_fd_all(fd_diskstats, content, sizeof(content)) <= 0) {
+		info->disk_kbps = -1;
+		return;
+	}
+	uint64_t sectors = 0;
+	for (const char *line = content; line && *line; line = next_line(line)) {
+		char name[32];
+		unsigned long long rd, wr;
+		if (sscanf(line, "%*u %*u %31s %*u %*u %llu %*u %*u %*u %llu", name, &rd, &wr) != 3) continue;
+		for (int i = 0; i < disk_count; i++) {
+			if (strcmp(name, disk_names[i]) == 0) {
+				sectors += rd + wr;
+				break;
+			}
+		}
+	}
+	info->disk_kbps = update_rate(&disk_rate, sectors * 512);
+}
+
+static int format_disk(const struct sysinfo *info, char *buf, size_t len) {
+	if (info->disk_kbps < 0) return 0;
+	char rate[16];
+	format_rate(info->disk_kbps, rate, sizeof(rate));
+	return snprintf(buf, len, "DISK %s", rate);
+}
 
-	fd_battery = open(BATTERY_PATH, O_RDONLY);
+/* Network throughput summed over all interfaces but loopback */
+static int fd_netdev = -1;
+static struct rate net_rx_rate, net_tx_rate;
 
-	snprintf(path, sizeof(path), "%s/brightness", BACKLIGHT_PATH);
-	fd_brightness = open(path, O_RDONLY);
-	snprintf(path, sizeof(path), "%s/max_brightness", BACKLIGHT_PATH);
-	fd_max_brightness = open(path, O_RDONLY);
-	cached_max_brightness = read_fd_int(fd_max_brightness);
+static bool discover_net(struct module *m) {
+	(void)m;
+	fd_netdev = track_fd(open("/proc/net/dev", O_RDONLY | O_CLOEXEC));
+	return fd_netdev >= 0;
+}
 
-	if (cached_hwmon_path[0]) {
-		snprintf(path, sizeof(path), "%s/temp1_input", cached_hwmon_path);
-		fd_cpu_temp = open(path, O_RDONLY);
+static void update_net(struct sysinfo *info) {
+	char content[8192];
+	if (read_fd_all(fd_netdev, content, sizeof(content)) <= 0) {
+		info->net_rx_kbps = info->net_tx_kbps = -1;
+		return;
+	}
+	uint64_t rx = 0, tx = 0;
+	for (const char *line = content; line && *line; line = next_line(line)) {
+		const char *colon = strchr(line, ':');
+		const char *eol = strchr(line, '\n');
+		if (!colon || (eol && colon > eol)) continue; /* header */
+		line += strspn(line, " ");
+		if (colon - line == 2 && strncmp(line, "lo", 2) == 0) continue;
+		unsigned long long r, t;
+		if (sscanf(colon + 1, "%llu %*u %*u %*u %*u %*u %*u %*u %llu", &r, &t) != 2) continue;
+		rx += r;
+		tx += t;
 	}
+	info->net_rx_kbps = update_rate(&net_rx_rate, rx);
+	info->net_tx_kbps = update_rate(&net_tx_rate, tx);
+}
 
-	fd_cpu_freq = open("/sys/devices/system/cpu/cpu0/cpufreq/scaling_cur_freq", O_RDONLY);
-	fd_meminfo = open("/proc/meminfo", O_RDONLY);
-	fd_wireless = open("/proc/net/wireless", O_RDONLY);
+static int format_net(const struct sysinfo *info, char *buf, size_t len) {
+	if (info->net_rx_kbps < 0 || info->net_tx_kbps < 0) return 0;
+	char rx[16], tx[16];
+	format_rate(info->net_rx_kbps, rx, sizeof(rx));
+	format_rate(info->net_tx_kbps, tx, sizeof(tx));
+	return snprintf(buf, len, "NET %s/%s", rx, tx);
+}
+
+/* Clock (24-hour format); the compositor rebuilds the text every minute */
+static bool discover_clock(struct module *m) {
+	(void)m;
+	return true;
+}
+
+static int format_clock(const struct sysinfo *info, char *buf, size_t len) {
+	(void)info;
+	time_t now = time(NULL);
+	const struct tm *tm = localtime(&now);
+	if (!tm) return 0;
+	return snprintf(buf, len, "%02d:%02d", tm->tm_hour, tm->tm_min);
+}
+
+static struct module modules[] = {
+	{ .name = "battery", .discover = discover_battery, .update = update_battery,
+	  .format = format_battery, .interval = INTERVAL_BATTERY },
+	{ .name = "backlight", .discover = discover_backlight, .update = update_backlight,
+	  .format = format_backlight, .interval = INTERVAL_BRIGHTNESS, .notified_interval = INTERVAL_NOTIFIED },
+	{ .name = "temp", .discover = discover_temp, .update = update_temp,
+	  .format = format_temp, .interval = INTERVAL_TEMP },
+	{ .name = "cpu", .discover = discover_cpu, .update = update_cpu,
+	  .format = format_cpu, .interval = INTERVAL_CPU },
+	{ .name = "cpufreq", .discover = discover_cpufreq, .update = update_cpufreq,
+	  .format = format_cpufreq, .interval = INTERVAL_CPUFREQ },
+	{ .name = "mem", .discover = discover_mem, .update = update_mem,
+	  .format = format_mem, .interval = INTERVAL_MEM },
+	{ .name = "wifi", .discover = discover_wifi, .update = update_wifi,
+	  .format = format_wifi, .interval = INTERVAL_WIFI },
+	{ .name = "bluetooth", .discover = discover_bluetooth, .update = update_bluetooth,
+	  .format = format_bluetooth, .interval = INTERVAL_BLUETOOTH, .notified_interval = INTERVAL_NOTIFIED },
+	{ .name = "caps", .discover = discover_caps, .update = update_caps,
+	  .format = format_caps, .interval = INTERVAL_CAPS },
+	{ .name = "load", .discover = discover_load, .update = update_load,
+	  .format = format_load, .interval = INTERVAL_LOAD },
+	{ .name = "disk", .discover = discover_disk, .update = update_disk,
+	  .format = format_disk, .interval = INTERVAL_DISK },
+	{ .name = "net", .discover = discover_net, .update = update_net,
+	  .format = format_net, .interval = INTERVAL_NET },
+	{ .name = "clock", .discover = discover_clock,
+	  .format = format_clock },
+};
+
+static void watch_fd(int fd, uint32_t events, uint32_t tag) {
+	if (fd < 0) return;
+	struct epoll_event ev = { .events = events, .data.u32 = tag };
+	epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+/* Open the thread's event sources; a missing notification falls back to polling */
+static void open_events(void) {
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd < 0) return;
+	timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	watch_fd(timer_fd, EPOLLIN, EV_TIMER);
+	watch_fd(wake_fd, EPOLLIN, EV_WAKE);
+	for (int i = 0; i < active_count; i++)
+		watch_fd(active[i]->event_fd, active[i]->events, (uint32_t)(EV_MODULE + i));
+}
+
+static void close_events(void) {
+	int *fds[] = { &epoll_fd, &timer_fd, &wake_fd };
+	for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); i++) {
+		if (*fds[i] >= 0) close(*fds[i]);
+		*fds[i] = -1;
+	}
+	for (int i = 0; i < module_fd_count; i++) close(module_fds[i]);
+	module_fd_count = 0;
+}
+
+static void drain_fd(int fd) {
+	char buf[4096];
+	while (read(fd, buf, sizeof(buf)) > 0) {}
+}
 
-	snprintf(path, sizeof(path), "/sys/class/net/%s/operstate", WIFI_IFACE);
-	fd_wifi_state = open(path, O_RDONLY);
+static void wake_thread(void) {
+	uint64_t one = 1;
+	if (wake_fd >= 0 && write(wake_fd, &one, sizeof(one)) < 0) return;
+}
 
-	if (cached_bt_rfkill[0]) {
-		snprintf(path, sizeof(path), "%s/soft", cached_bt_rfkill);
-		fd_bt_soft = open(path, O_RDONLY);
-		snprintf(path, sizeof(path), "%s/hard", cached_bt_rfkill);
-		fd_bt_hard = open(path, O_RDONLY);
+/* Enable the modules named in RWM_STATUS (or the defaults) that pass discovery */
+static void discover_modules(void) {
+	const char *list = getenv("RWM_STATUS");
+	char names[256];
+	snprintf(names, sizeof(names), "%s", list ? list : DEFAULT_MODULES);
+	char *save = NULL;
+	for (char *name = strtok_r(names, ", ", &save); name; name = strtok_r(NULL, ", ", &save)) {
+		for (size_t i = 0; i < sizeof(modules) / sizeof(modules[0]); i++) {
+			struct module *m = &modules[i];
+			if (strcmp(m->name, name) != 0 || m->listed || active_count == SYSINFO_MAX_MODULES) continue;
+			m->listed = true;
+			m->event_fd = -1;
+			if (m->discover(m)) active[active_count++] = m;
+			break;
+		}
+	}
+	for (size_t i = 0; i < sizeof(modules) / sizeof(modules[0]); i++) {
+		struct module *m = &modules[i];
+		if (!m->sampled || m->listed || active_count == SYSINFO_MAX_MODULES) continue;
+		m->listed = true;
+		m->hidden = true;
+		m->event_fd = -1;
+		if (m->discover(m)) active[active_count++] = m;
 	}
+}
 
-	fd_capslock = open("/sys/class/leds/input0::capslock/brightness", O_RDONLY);
+/* Profiling data, owned by the sysinfo thread and published with the values */
+static struct sysinfo_profile profile_times;
+
+static bool sysinfo_equal(const struct sysinfo *a, const struct sysinfo *b) {
+	return a->battery_percent == b->battery_percent &&
+		a->brightness_percent == b->brightness_percent &&
+		a->cpu_temp_c == b->cpu_temp_c &&
+		a->cpu_freq_mhz == b->cpu_freq_mhz &&
+		a->cpu_freq_min_mhz == b->cpu_freq_min_mhz &&
+		a->cpu_freq_max_mhz == b->cpu_freq_max_mhz &&
+		a->cpu_util_min == b->cpu_util_min &&
+		a->cpu_util_avg == b->cpu_util_avg &&
+		a->cpu_util_max == b->cpu_util_max &&
+		a->cpu_history_len == b->cpu_history_len &&
+		memcmp(a->cpu_history, b->cpu_history, sizeof(a->cpu_history)) == 0 &&
+		a->mem_used_percent == b->mem_used_percent &&
+		a->wifi_signal_dbm == b->wifi_signal_dbm &&
+		a->load_avg_x100 == b->load_avg_x100 &&
+		a->disk_kbps == b->disk_kbps &&
+		a->net_rx_kbps == b->net_rx_kbps &&
+		a->net_tx_kbps == b->net_tx_kbps &&
+		a->wifi_connected == b->wifi_connected &&
+		a->bluetooth_on == b->bluetooth_on &&
+		a->caps_lock == b->caps_lock;
+}
+/* Caller holds info_mutex */
+static void publish(const struct sysinfo *info, const struct sysinfo_profile *profile) {
+	bool changed = !sysinfo_equal(info, &shared_info);
+	unsigned seq = atomic_load_explicit(&shared_seq, memory_order_relaxed);
+	atomic_store_explicit(&shared_seq, seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	shared_info = *info;
+	if (profile) shared_profile = *profile;
+	atomic_store_explicit(&shared_seq, seq + 2, memory_order_release);
+	if (changed) {
+		atomic_fetch_add_explicit(&shared_gen, 1, memory_order_release);
+		uint64_t one = 1;
+		if (notify_fd >= 0 && write(notify_fd, &one, sizeof(one)) < 0) return;
+	}
 }
 
-/* Profiling data */
-static struct {
-	double battery_us;
-	double brightness_us;
-	double cpu_temp_us;
-	double cpu_freq_us;
-	double mem_us;
-	double wifi_signal_us;
-	double wifi_state_us;
-	double bluetooth_us;
-	double capslock_us;
-} profile_times;
+static void read_published(struct sysinfo *info, struct sysinfo_profile *profile) {
+	unsigned before, after;
+	do {
+		before = atomic_load_explicit(&shared_seq, memory_order_acquire);
+		if (info) *info = shared_info;
+		if (profile) *profile = shared_profile;
+		atomic_thread_fence(memory_order_acquire);
+		after = atomic_load_explicit(&shared_seq, memory_order_relaxed);
+	} while ((before & 1) || before != after);
+}
 
 static double time_diff_us(const struct timespec *start, const struct timespec *end) {
 	return (double)(end->tv_sec - start->tv_sec) * 1000000.0 +
 	       (double)(end->tv_nsec - start->tv_nsec) / 1000.0;
 }
 
-#define PROFILE(field, call) do { \
+#define PROFILE(i, call) do { \
 	struct timespec _start, _end; \
 	clock_gettime(CLOCK_MONOTONIC, &_start); \
 	(call); \
 	clock_gettime(CLOCK_MONOTONIC, &_end); \
-	profile_times.field = time_diff_us(&_start, &_end); \
+	profile_times.us[i] = time_diff_us(&_start, &_end); \
 } while(0)
 
-/* Background thread function */
+static int module_interval(const struct module *m) {
+	return m->event_fd >= 0 && m->notified_interval ? m->notified_interval : m->interval;
+}
+
+/* Block until the timer fires at deadline (ms, CLOCK_MONOTONIC) or an event
+   arrives, and mark the modules those events concern as due */
+static void wait_events(uint64_t deadline) {
+	if (epoll_fd < 0 || timer_fd < 0) {
+		uint64_t now = now_ms();
+		struct timespec ts = { 0, 0 };
+		if (deadline > now) {
+			ts.tv_sec = (time_t)((deadline - now) / 1000);
+			ts.tv_nsec = (long)((deadline - now) % 1000) * 1000000;
+		}
+		nanosleep(&ts, NULL);
+		return;
+	}
+	struct itimerspec its = { .it_value = {
+		(time_t)(deadline / 1000), (long)(deadline % 1000) * 1000000 } };
+	timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+
+	struct epoll_event events[8];
+	int n = epoll_wait(epoll_fd, events, 8, -1);
+	for (int i = 0; i < n; i++) {
+		uint32_t tag = events[i].data.u32;
+		if (tag == EV_WAKE || tag == EV_TIMER) {
+			drain_fd(tag == EV_WAKE ? wake_fd : timer_fd);
+			continue;
+		}
+		struct module *m = active[tag - EV_MODULE];
+		if (m->events & EPOLLPRI)
+			read_fd_int(m->event_fd); /* re-arms the notification */
+		else
+			drain_fd(m->event_fd);
+		m->due = true;
+	}
+}
+
+/* Background thread function. Each module has its own deadline; deadlines
+   keep their phase, so modules on the same interval share one wakeup. */
 static void *sysinfo_thread_fn(void *arg) {
 	(void)arg;
 
-	time_t last_battery = 0, last_brightness = 0, last_cpu = 0;
-	time_t last_mem = 0, last_wifi = 0, last_bt = 0, last_caps = 0;
-
 	while (atomic_load(&sysinfo_running)) {
-		time_t now = time(NULL);
+		apply_brightness_request();
+		uint64_t now = now_ms();
 		struct sysinfo local;
 
-		/* Copy current values */
+		/* Copy current values; only writers change them, and they hold the lock */
 		pthread_mutex_lock(&info_mutex);
 		local = shared_info;
 		pthread_mutex_unlock(&info_mutex);
 
-		/* Update metrics based on their intervals */
-		if (now - last_battery >= INTERVAL_BATTERY) {
-			PROFILE(battery_us, local.battery_percent = get_battery_percent());
-			last_battery = now;
-		}
-		if (now - last_brightness >= INTERVAL_BRIGHTNESS) {
-			PROFILE(brightness_us, local.brightness_percent = get_brightness_percent());
-			last_brightness = now;
-		}
-		if (now - last_cpu >= INTERVAL_CPU) {
-			PROFILE(cpu_temp_us, local.cpu_temp_c = get_cpu_temp_c());
-			PROFILE(cpu_freq_us, local.cpu_freq_mhz = get_cpu_freq_mhz());
-			last_cpu = now;
-		}
-		if (now - last_mem >= INTERVAL_MEM) {
-			PROFILE(mem_us, local.mem_used_percent = get_mem_used_percent());
-			last_mem = now;
-		}
-		if (now - last_wifi >= INTERVAL_WIFI) {
-			PROFILE(wifi_signal_us, local.wifi_signal_dbm = get_wifi_signal_dbm());
-			PROFILE(wifi_state_us, local.wifi_connected = get_wifi_connected());
-			last_wifi = now;
-		}
-		if (now - last_bt >= INTERVAL_BLUETOOTH) {
-			PROFILE(bluetooth_us, local.bluetooth_on = get_bluetooth_on());
-			last_bt = now;
-		}
-		if (now - last_caps >= INTERVAL_CAPS) {
-			PROFILE(capslock_us, local.caps_lock = get_caps_lock());
-			last_caps = now;
+		uint64_t next = UINT64_MAX;
+		for (int i = 0; i < active_count; i++) {
+			struct module *m = active[i];
+			if (!m->update) continue;
+			uint64_t interval = (uint64_t)module_interval(m) * 1000;
+			if (m->due || m->deadline <= now) {
+				PROFILE(i, m->update(&local));
+				m->due = false;
+			}
+			if (m->deadline <= now)
+				m->deadline = m->deadline && m->deadline + interval > now ? m->deadline + interval : now + interval;
+			if (m->deadline < next) next = m->deadline;
 		}
 
-		/* Update shared state */
+		/* Update shared state; a brightness request made meanwhile stands */
 		pthread_mutex_lock(&info_mutex);
-		shared_info = local;
+		if (brightness_request >= 0) local.brightness_percent = shared_info.brightness_percent;
+		publish(&local, &profile_times);
 		pthread_mutex_unlock(&info_mutex);
 
-		struct timespec ts = {0, 100000000}; /* 100ms */
-		nanosleep(&ts, NULL);
+		wait_events(next);
 	}
 	return NULL;
 }
 
 void sysinfo_start(void) {
-	/* Discover paths once */
-	find_hwmon_by_name("coretemp", cached_hwmon_path, sizeof(cached_hwmon_path));
-	find_bt_rfkill(cached_bt_rfkill, sizeof(cached_bt_rfkill));
-
-	/* Open all file descriptors */
-	open_fds();
+	/* Discover the modules once; they keep their fds open. The backlight
+	   serves the brightness keys whether or not its module is listed. */
+	open_backlight();
+	discover_modules();
+	open_events();
+	notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
 
 	/* Initialize shared info */
-	shared_info = (struct sysinfo){-1, -1, -1, -1, -1, -1, false, false, false};
+	shared_info = (struct sysinfo){
+		.battery_percent = -1, .brightness_percent = -1, .cpu_temp_c = -1,
+		.cpu_freq_mhz = -1, .cpu_freq_min_mhz = -1, .cpu_freq_max_mhz = -1,
+		.cpu_util_min = -1, .cpu_util_avg = -1, .cpu_util_max = -1,
+		.mem_used_percent = -1, .wifi_signal_dbm = -1, .load_avg_x100 = -1,
+		.disk_kbps = -1, .net_rx_kbps = -1, .net_tx_kbps = -1 };
+	profile_times.count = active_count;
+	for (int i = 0; i < active_count; i++) profile_times.name[i] = active[i]->name;
+	shared_profile = profile_times;
 
 	/* Start background thread */
 	atomic_store(&sysinfo_running, true);
 	pthread_create(&sysinfo_thread, NULL, sysinfo_thread_fn, NULL);
 }
 
+void sysinfo_sample(const char *name) {
+	for (size_t i = 0; i < sizeof(modules) / sizeof(modules[0]); i++)
+		if (strcmp(modules[i].name, name) == 0) modules[i].sampled = true;
+}
+
 void sysinfo_stop(void) {
 	atomic_store(&sysinfo_running, false);
+	wake_thread();
 	pthread_join(sysinfo_thread, NULL);
+	close_events();
+	if (notify_fd >= 0) close(notify_fd);
+	notify_fd = -1;
+}
+
+int sysinfo_notify_fd(void) {
+	return notify_fd;
+}
+
+void sysinfo_ack_notify(void) {
+	uint64_t count;
+	if (notify_fd >= 0 && read(notify_fd, &count, sizeof(count)) < 0) return;
 }
 
 void sysinfo_get(struct sysinfo *info) {
-	pthread_mutex_lock(&info_mutex);
-	*info = shared_info;
-	pthread_mutex_unlock(&info_mutex);
+	read_published(info, NULL);
+}
+
+unsigned sysinfo_generation(void) {
+	return atomic_load_explicit(&shared_gen, memory_order_acquire);
 }
 
 void sysinfo_get_profile(struct sysinfo_profile *p) {
-	p->battery_us = profile_times.battery_us;
-	p->brightness_us = profile_times.brightness_us;
-	p->cpu_temp_us = profile_times.cpu_temp_us;
-	p->cpu_freq_us = profile_times.cpu_freq_us;
-	p->mem_us = profile_times.mem_us;
-	p->wifi_signal_us = profile_times.wifi_signal_us;
-	p->wifi_state_us = profile_times.wifi_state_us;
-	p->bluetooth_us = profile_times.bluetooth_us;
-	p->capslock_us = profile_times.capslock_us;
+	read_published(NULL, p);
 }
 
 /* Legacy synchronous update (deprecated, but kept for compatibility) */
@@ -393,13 +1132,14 @@ void sysinfo_update(struct sysinfo *info) {
 	sysinfo_get(info);
 }
 
-void sysinfo_adjust_brightness(int delta) {
-	char path[128];
-	snprintf(path, sizeof(path), "%s/brightness", BACKLIGHT_PATH);
-	int cur = read_file_int(path);
-	snprintf(path, sizeof(path), "%s/max_brightness", BACKLIGHT_PATH);
-	int max = read_file_int(path);
-	if (cur < 0 || max <= 0) return;
+int sysinfo_adjust_brightness(int delta) {
+	int max = cached_max_brightness;
+	pthread_mutex_lock(&info_mutex);
+	int cur = brightness_request >= 0 ? brightness_request : brightness_raw;
+	if (cur < 0 || max <= 0) {
+		pthread_mutex_unlock(&info_mutex);
+		return -1;
+	}
 
 	int step = max / 20; /* 5% steps */
 	if (step < 1) step = 1;
@@ -407,62 +1147,66 @@ void sysinfo_adjust_brightness(int delta) {
 	if (newval < 1) newval = 1;
 	if (newval > max) newval = max;
 
-	snprintf(path, sizeof(path), "%s/brightness", BACKLIGHT_PATH);
-	FILE *f = fopen(path, "w");
-	if (f) { fprintf(f, "%d", newval); fclose(f); }
+	brightness_request = newval;
+	brightness_raw = newval;
+	struct sysinfo info = shared_info;
+	info.brightness_percent = (newval * 100) / max;
+	publish(&info, NULL);
+	pthread_mutex_unlock(&info_mutex);
+	wake_thread();
+	return (newval * 100) / max;
 }
 
-const char *sysinfo_format_status(const struct sysinfo *info) {
-	static char buf[256];
-	char *p = buf;
-	const char *end = buf + sizeof(buf);
-
-	/* Battery */
-	if (info->battery_percent >= 0)
-		p += snprintf(p, (size_t)(end - p), "BAT %d%%", info->battery_percent);
+/* Parse the same snapshot many times so only the parsing is measured */
+static double bench_parser(int (*parse)(const char *), const char *content) {
+	enum { ITERATIONS = 20000 };
+	volatile int sink = 0;
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < ITERATIONS; i++) sink += parse(content);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	(void)sink;
+	return time_diff_us(&start, &end) * 1000.0 / ITERATIONS;
+}
 
-	/* Brightness */
-	if (info->brightness_percent >= 0)
-		p += snprintf(p, (size_t)(end - p), "%sBRI %d%%", p > buf ? "  " : "", info->brightness_percent);
+static int bench_parse_stat(const char *content) {
+	static uint64_t busy[MAX_CPUS], total[MAX_CPUS];
+	return parse_stat(content, busy, total, MAX_CPUS);
+}
 
-	/* CPU temp */
-	if (info->cpu_temp_c >= 0)
-		p += snprintf(p, (size_t)(end - p), "%s%d°C", p > buf ? "  " : "", info->cpu_temp_c);
+static ssize_t read_snapshot(const char *path, char *buf, size_t len) {
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return -1;
+	ssize_t n = read_fd_all(fd, buf, len);
+	close(fd);
+	return n;
+}
 
-	/* CPU freq */
-	if (info->cpu_freq_mhz >= 0) {
-		if (info->cpu_freq_mhz >= 1000)
-			p += snprintf(p, (size_t)(end - p), "%s%.1fGHz", p > buf ? "  " : "", info->cpu_freq_mhz / 1000.0);
-		else
-			p += snprintf(p, (size_t)(end - p), "%s%dMHz", p > buf ? "  " : "", info->cpu_freq_mhz);
+void sysinfo_bench(struct sysinfo_bench *b) {
+	static char mem[1024], stat[STAT_BUF_SIZE];
+	*b = (struct sysinfo_bench){ -1, -1, -1, 0 };
+	if (read_snapshot("/proc/meminfo", mem, sizeof(mem)) > 0) {
+		b->mem_sscanf_ns = bench_parser(parse_mem_used_percent_sscanf, mem);
+		b->mem_scan_ns = bench_parser(parse_mem_used_percent, mem);
 	}
-
-	/* Memory */
-	if (info->mem_used_percent >= 0)
-		p += snprintf(p, (size_t)(end - p), "%sMEM %d%%", p > buf ? "  " : "", info->mem_used_percent);
-
-	/* WiFi */
-	if (info->wifi_connected) {
-		if (info->wifi_signal_dbm != -1)
-			p += snprintf(p, (size_t)(end - p), "%sWiFi %ddBm", p > buf ? "  " : "", info->wifi_signal_dbm);
-		else
-			p += snprintf(p, (size_t)(end - p), "%sWiFi", p > buf ? "  " : "");
+	if (read_snapshot("/proc/stat", stat, sizeof(stat)) > 0) {
+		b->stat_scan_ns = bench_parser(bench_parse_stat, stat);
+		b->cpus = bench_parse_stat(stat);
 	}
+}
 
-	/* Bluetooth */
-	if (info->bluetooth_on)
-		p += snprintf(p, (size_t)(end - p), "%sBT", p > buf ? "  " : "");
-
-	/* Caps Lock */
-	if (info->caps_lock)
-		p += snprintf(p, (size_t)(end - p), "%sCAPS", p > buf ? "  " : "");
-
-	/* Time (24-hour format) */
-	time_t now = time(NULL);
-	const struct tm *tm = localtime(&now);
-	if (tm)
-		(void)snprintf(p, (size_t)(end - p), "%s%02d:%02d", p > buf ? "  " : "",
-			tm->tm_hour, tm->tm_min);
-
+const char *sysinfo_format_status(const struct sysinfo *info) {
+	static char buf[256];
+	size_t len = 0;
+	buf[0] = '\0';
+	for (int i = 0; i < active_count && len < sizeof(buf) - 1; i++) {
+		char item[64];
+		if (active[i]->hidden || active[i]->format(info, item, sizeof(item)) <= 0) continue;
+		size_t sep = len ? 2 : 0, n = strlen(item);
+		if (sep + n >= sizeof(buf) - len) break; /* items that don't fit are left out */
+		memcpy(buf + len, "  ", sep);
+		memcpy(buf + len + sep, item, n + 1);
+		len += sep + n;
+	}
 	return buf;
 }
@@ -3,49 +3,82 @@
 
 #include <stdbool.h>
 
+#define SYSINFO_HISTORY 16
+
 /* System information structure - all values are -1 if unavailable */
 struct sysinfo {
 	int battery_percent;      /* 0-100 */
 	int brightness_percent;   /* 0-100 */
 	int cpu_temp_c;           /* degrees celsius */
-	int cpu_freq_mhz;         /* MHz */
+	int cpu_freq_mhz;         /* MHz, average over all CPUs */
+	int cpu_freq_min_mhz;     /* slowest cpufreq policy */
+	int cpu_freq_max_mhz;     /* fastest cpufreq policy */
+	int cpu_util_min;         /* 0-100, idlest core */
+	int cpu_util_avg;         /* 0-100, mean over cores */
+	int cpu_util_max;         /* 0-100, busiest core */
 	int mem_used_percent;     /* 0-100 */
 	int wifi_signal_dbm;      /* dBm (negative, e.g. -50) */
+	int load_avg_x100;        /* 1-minute load average * 100 */
+	int disk_kbps;            /* KiB/s read and written */
+	int net_rx_kbps;          /* KiB/s received */
+	int net_tx_kbps;          /* KiB/s sent */
 	bool wifi_connected;
 	bool bluetooth_on;
 	bool caps_lock;
+	unsigned char cpu_history[SYSINFO_HISTORY];  /* cpu_util_avg samples, oldest first */
+	int cpu_history_len;
 };
 
-/* Profiling data for each metric (microseconds) */
+#define SYSINFO_MAX_MODULES 16
+
+/* Profiling data for each enabled status module (microseconds) */
 struct sysinfo_profile {
-	double battery_us;
-	double brightness_us;
-	double cpu_temp_us;
-	double cpu_freq_us;
-	double mem_us;
-	double wifi_signal_us;
-	double wifi_state_us;
-	double bluetooth_us;
-	double capslock_us;
+	int count;
+	const char *name[SYSINFO_MAX_MODULES];
+	double us[SYSINFO_MAX_MODULES];
 };
 
-/* Start background thread for gathering system info */
+/* Start background thread for gathering system info. RWM_STATUS lists the
+   status modules to show, in order; those whose hardware is missing are
+   left out */
 void sysinfo_start(void);
 
+/* Update the named module even if RWM_STATUS leaves it out, without
+   showing it in the status text; call before sysinfo_start */
+void sysinfo_sample(const char *name);
+
 /* Stop background thread */
 void sysinfo_stop(void);
 
 /* Get current cached sysinfo (non-blocking) */
 void sysinfo_get(struct sysinfo *info);
 
+/* Bumped whenever the cached sysinfo changes */
+unsigned sysinfo_generation(void);
+
+/* Readable when the generation changed; sysinfo_ack_notify resets it */
+int sysinfo_notify_fd(void);
+void sysinfo_ack_notify(void);
+
 /* Get profiling data (last update times in microseconds) */
 void sysinfo_get_profile(struct sysinfo_profile *p);
 
 /* Fill sysinfo struct with current values (legacy, calls sysinfo_get) */
 void sysinfo_update(struct sysinfo *info);
 
-/* Adjust screen brightness by delta steps (positive = brighter) */
-void sysinfo_adjust_brightness(int delta);
+/* Adjust screen brightness by delta steps (positive = brighter). The write
+   happens on the background thread; returns the new percentage, or -1 */
+int sysinfo_adjust_brightness(int delta);
+
+/* Time the proc file parsers on snapshots of the real files (nanoseconds per
+   parse, -1 if unreadable); the sscanf variant is the previous meminfo parser */
+struct sysinfo_bench {
+	double mem_sscanf_ns;
+	double mem_scan_ns;
+	double stat_scan_ns;
+	int cpus;
+};
+void sysinfo_bench(struct sysinfo_bench *b);
 
 /* Format status string for display (returns static buffer) */
 const char *sysinfo_format_status(const struct sysinfo *info);